@@ -0,0 +1,90 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ *
+ * async_example.cpp
+ *
+ *  Created on: Mar 9, 2017
+ *      Author: nico
+ *
+ *  compresses the input files with rp_async (all jobs submitted at once), decompresses the
+ *  archives and checks that the files are rebuilt. Exits with status 1 if a file is not.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "internal/rp_async.hpp"
+
+using namespace std;
+
+string read_file(string path){
+
+	ifstream ifs(path, ios::binary);
+	return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+
+}
+
+int main(int argc, char** argv){
+
+	if(argc < 2){
+
+		cout << "Usage: async_example <file1> [file2 ...]" << endl;
+		cout << "Compresses each file to <file>.rp and decompresses it to <file>.rp.out" << endl;
+		exit(0);
+
+	}
+
+	//small budget: jobs larger than it run one at a time
+	rp_async32_t R(uint64_t(1)<<26, 2);
+
+	vector<string> files(argv+1, argv+argc);
+	vector<rp_async32_t::job> jobs;
+
+	for(auto f : files)
+		jobs.push_back(R.compress_async(f, f + ".rp"));
+
+	bool ok = true;
+
+	for(uint64_t i=0;i<files.size();++i){
+
+		if(jobs[i].wait() != RP_JOB_DONE){
+
+			cout << "Error: could not compress " << files[i] << endl;
+			ok = false;
+			continue;
+
+		}
+
+		auto st = R.decompress_async(files[i] + ".rp", files[i] + ".rp.out").wait();
+
+		if(st != RP_JOB_DONE or read_file(files[i]) != read_file(files[i] + ".rp.out")){
+
+			cout << "Error: " << files[i] << " was not rebuilt" << endl;
+			ok = false;
+			continue;
+
+		}
+
+		cout << files[i] << ": OK" << endl;
+
+	}
+
+	return ok ? 0 : 1;
+
+}
@@ -0,0 +1,98 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ *
+ * message_example.cpp
+ *
+ *  Created on: Mar 10, 2017
+ *      Author: nico
+ *
+ *  sends each line of the input file (or a stream of generated log events) through a pair of
+ *  message_context, checks that every message is received unchanged and that a truncated
+ *  message is rejected. Exits with status 1 on failure.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "internal/message_context.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv){
+
+	vector<string> messages;
+
+	if(argc > 1){
+
+		ifstream ifs(argv[1]);
+
+		if(not ifs.good()){
+
+			cout << "Error: could not open " << argv[1] << endl;
+			exit(1);
+
+		}
+
+		string line;
+		while(getline(ifs,line)) messages.push_back(line);
+
+	}else{
+
+		for(int i=0;i<10000;++i)
+			messages.push_back(	"{\"level\":\"" + string(i%7 ? "info" : "warn") +
+								"\",\"user\":" + to_string(i*37%1000) +
+								",\"event\":\"request\",\"ms\":" + to_string(i%250) + "}");
+
+	}
+
+	//small context, so that rules get evicted
+	message_context<> sender(1<<10, 1<<12), receiver(1<<10, 1<<12);
+
+	uint64_t bytes = 0;
+	uint64_t code_bytes = 0;
+
+	for(auto & msg : messages){
+
+		string code = sender.compress_message(msg);
+
+		//a truncated message must be rejected without touching the receiver
+		string msg2;
+		if(code.size() > 1 and receiver.decompress_message(code.substr(0,code.size()-1), msg2)){
+
+			cout << "Error: truncated message accepted" << endl;
+			return 1;
+
+		}
+
+		if(not receiver.decompress_message(code, msg2) or msg2 != msg){
+
+			cout << "Error: message not received unchanged: " << msg << endl;
+			return 1;
+
+		}
+
+		bytes += msg.size();
+		code_bytes += code.size();
+
+	}
+
+	cout << messages.size() << " messages, " << bytes << " Bytes sent as " << code_bytes << " Bytes" << endl;
+
+	return 0;
+
+}
@@ -0,0 +1,313 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * column_layout.hpp
+ *
+ *  Created on: Mar 6, 2017
+ *      Author: nico
+ *
+ *  record layout of a delimited text (CSV, TSV, ...) split into per-column streams.
+ *
+ *  Records are separated by '\n' and fields by a delimiter character. The i-th field of every
+ *  record goes to the i-th column stream, terminated by '\n' (which cannot appear inside fields).
+ *  Each column is compressed with its own grammar; the grammars are then merged into a single
+ *  archive whose compressed text is the concatenation of the columns' compressed texts.
+ *
+ *  The layout (stored in section RP_SECTION_COLUMNS) is:
+ *
+ *  	<delimiter, final_newline, R, (fields_1, run_1), ..., (fields_R, run_R), C, t_1, ..., t_C>
+ *
+ *  where the number of fields per record is run-length encoded in R runs, C is the number of
+ *  columns and t_i is the length of the i-th column's compressed text.
+ *
+ */
+
+#ifndef INTERNAL_COLUMN_LAYOUT_HPP_
+#define INTERNAL_COLUMN_LAYOUT_HPP_
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "grammar.hpp"
+#include "rp_archive.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class column_layout{
+
+public:
+
+	column_layout(){}
+
+	/*
+	 * read the layout from the payload of section RP_SECTION_COLUMNS
+	 */
+	column_layout(vector<itype> & payload){
+
+		uint64_t i = 0;
+
+		delimiter = payload[i++];
+		final_newline = payload[i++];
+
+		uint64_t R = payload[i++];
+
+		for(uint64_t r=0;r<R;++r){
+
+			itype f = payload[i++];
+			itype l = payload[i++];
+
+			runs.push_back({f,l});
+
+		}
+
+		uint64_t C = payload[i++];
+
+		for(uint64_t c=0;c<C;++c) column_text_length.push_back(payload[i++]);
+
+		assert(i == payload.size());
+
+	}
+
+	/*
+	 * split the content of stream in into per-column streams. The layout is recorded
+	 * in this object, except the columns' compressed text lengths (see merge)
+	 */
+	vector<string> split(istream & in, char delimiter){
+
+		this->delimiter = uint8_t(delimiter);
+
+		vector<string> columns;
+
+		string line;
+
+		while(std::getline(in,line)){
+
+			final_newline = not in.eof();
+
+			itype fields = 0;
+			uint64_t begin = 0;
+
+			while(true){
+
+				uint64_t end = line.find(delimiter,begin);
+				end = end == string::npos ? line.size() : end;
+
+				if(fields == columns.size()) columns.push_back(string());
+
+				columns[fields].append(line,begin,end-begin);
+				columns[fields].push_back('\n');
+
+				fields++;
+
+				if(end == line.size()) break;
+
+				begin = end+1;
+
+			}
+
+			if(runs.size() > 0 and runs.back().first == fields){
+
+				runs.back().second++;
+
+			}else{
+
+				runs.push_back({fields,1});
+
+			}
+
+		}
+
+		return columns;
+
+	}
+
+	/*
+	 * merge the grammars of the columns (container of engines E[0], ..., E[C-1], each exposing A, G, T_vec,
+	 * text_crc, text_length) into archive arc. Terminals are mapped to a shared alphabet and the rules of column c
+	 * are shifted after those of columns 0, ..., c-1, so that children still precede parents.
+	 */
+	template<typename engines_t>
+	void merge(engines_t & E, rp_archive<itype> & arc){
+
+		const itype null = ~itype(0);
+
+		vector<itype> char_to_int(256,null);
+
+		arc.A = {};
+		arc.G = {};
+		arc.T = {};
+
+		for(auto & e : E){
+
+			for(auto a : e.A){
+
+				if(char_to_int[a] == null){
+
+					char_to_int[a] = arc.A.size();
+					arc.A.push_back(a);
+
+				}
+
+			}
+
+		}
+
+		itype sigma = arc.A.size();
+
+		uint32_t crc = 0;
+		uint64_t n = 0;
+
+		column_text_length = {};
+
+		for(auto & e : E){
+
+			itype sigma_c = e.A.size();
+			itype offset = sigma + arc.G.size();
+
+			auto map = [&](itype X){
+
+				return X < sigma_c ? char_to_int[e.A[X]] : offset + (X - sigma_c);
+
+			};
+
+			for(auto ab : e.G) arc.G.push_back({map(ab.first),map(ab.second)});
+			for(auto X : e.T_vec) arc.T.push_back(map(X));
+
+			column_text_length.push_back(e.T_vec.size());
+
+			crc = crc32c::combine(crc,e.text_crc,e.text_length);
+			n += e.text_length;
+
+			//free memory
+			e.A = {};
+			e.G = {};
+			e.T_vec = {};
+
+		}
+
+		arc.set_section(RP_SECTION_COLUMNS, serialize());
+
+		//the checksum is the one of the grammar's expansion, i.e. of the concatenated columns
+		arc.set_section(RP_SECTION_CRC32C, {crc, itype(n)});
+
+	}
+
+	/*
+	 * re-interleave the columns expanded from G and write the original text to ofs
+	 */
+	void expand(grammar<itype> & G, ofstream & ofs){
+
+		vector<grammar_iterator<itype> > columns;
+
+		uint64_t b = 0;
+
+		for(auto t : column_text_length){
+
+			columns.push_back(grammar_iterator<itype>(&G,b,b+t));
+			b += t;
+
+		}
+
+		assert(b == G.text().size());
+
+		string buffer;
+		uint64_t buf_size = 1000000;//1 MB buffer
+
+		uint64_t records = 0;
+		for(auto r : runs) records += r.second;
+
+		uint64_t record = 0;
+
+		for(auto r : runs){
+
+			for(itype k = 0;k<r.second;++k){
+
+				for(itype c = 0;c<r.first;++c){
+
+					if(c > 0) buffer.push_back(char(delimiter));
+
+					assert(columns[c].has_next());
+
+					uint8_t x;
+					while((x = columns[c].next()) != '\n') buffer.push_back(char(x));
+
+				}
+
+				record++;
+
+				if(record < records or final_newline) buffer.push_back('\n');
+
+				if(buffer.size() >= buf_size){
+
+					ofs.write(buffer.c_str(),buffer.size());
+					buffer = string();
+
+				}
+
+			}
+
+		}
+
+		if(buffer.size()>0) ofs.write(buffer.c_str(),buffer.size());
+
+	}
+
+	itype number_of_columns(){
+		return column_text_length.size();
+	}
+
+	uint64_t number_of_records(){
+
+		uint64_t records = 0;
+		for(auto r : runs) records += r.second;
+
+		return records;
+
+	}
+
+private:
+
+	vector<itype> serialize(){
+
+		vector<itype> payload = {delimiter, final_newline, itype(runs.size())};
+
+		for(auto r : runs){
+
+			payload.push_back(r.first);
+			payload.push_back(r.second);
+
+		}
+
+		payload.push_back(column_text_length.size());
+		for(auto t : column_text_length) payload.push_back(t);
+
+		return payload;
+
+	}
+
+	itype delimiter = 0;
+	itype final_newline = 0; //1 iff the last record is terminated by '\n'
+
+	//runs <number of fields, number of consecutive records with that number of fields>
+	vector<pair<itype,itype> > runs;
+
+	//length of the compressed text of each column
+	vector<uint64_t> column_text_length;
+
+};
+
+#endif /* INTERNAL_COLUMN_LAYOUT_HPP_ */
@@ -0,0 +1,148 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * crc32c.hpp
+ *
+ *  Created on: Mar 2, 2017
+ *      Author: nico
+ *
+ *  CRC32C (Castagnoli polynomial) checksums. Besides the usual byte-wise update,
+ *  the checksum of a concatenation UV can be computed from crc(U), crc(V) and |V|
+ *  in O(log |V|) time. This allows computing the checksum of a grammar's expansion
+ *  bottom-up, without expanding it.
+ *
+ */
+
+#ifndef INTERNAL_CRC32C_HPP_
+#define INTERNAL_CRC32C_HPP_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace crc32c{
+
+//reflected Castagnoli polynomial
+const uint32_t POLY = 0x82F63B78;
+
+/*
+ * table for byte-wise update
+ */
+struct crc_table{
+
+	crc_table(){
+
+		for(uint32_t i=0;i<256;++i){
+
+			uint32_t c = i;
+
+			for(int k=0;k<8;++k) c = c & 1 ? (c >> 1) ^ POLY : c >> 1;
+
+			byte[i] = c;
+
+		}
+
+		//x2n[k] = x^(2^k) modulo POLY
+		x2n[0] = uint32_t(1) << 30;
+		for(int k=1;k<64;++k) x2n[k] = multmodp(x2n[k-1],x2n[k-1]);
+
+	}
+
+	/*
+	 * a*b modulo POLY (polynomials in reflected representation)
+	 */
+	static uint32_t multmodp(uint32_t a, uint32_t b){
+
+		uint32_t m = uint32_t(1) << 31;
+		uint32_t p = 0;
+
+		while(true){
+
+			if(a & m){
+
+				p ^= b;
+
+				if((a & (m - 1)) == 0) break;
+
+			}
+
+			m >>= 1;
+			b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+
+		}
+
+		return p;
+
+	}
+
+	uint32_t byte[256];
+	uint32_t x2n[64];
+
+};
+
+inline const crc_table & table(){
+
+	static const crc_table t;
+	return t;
+
+}
+
+/*
+ * extend checksum crc with len bytes from buf. Use crc = 0 for the empty string.
+ */
+inline uint32_t update(uint32_t crc, const uint8_t * buf, uint64_t len){
+
+	auto & t = table();
+
+	crc = ~crc;
+
+	for(uint64_t i=0;i<len;++i) crc = t.byte[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+
+}
+
+inline uint32_t update(uint32_t crc, uint8_t c){
+
+	return update(crc,&c,1);
+
+}
+
+/*
+ * return crc(UV), given crc1 = crc(U), crc2 = crc(V) and len2 = |V|
+ */
+inline uint32_t combine(uint32_t crc1, uint32_t crc2, uint64_t len2){
+
+	auto & t = table();
+
+	//compute x^(8*len2) modulo POLY
+	uint32_t p = uint32_t(1) << 31;
+	int k = 3;
+
+	while(len2){
+
+		if(len2 & 1) p = crc_table::multmodp(t.x2n[k & 63], p);
+
+		len2 >>= 1;
+		k++;
+
+	}
+
+	return crc_table::multmodp(p, crc1) ^ crc2;
+
+}
+
+}
+
+#endif /* INTERNAL_CRC32C_HPP_ */
@@ -0,0 +1,434 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * fasta_layout.hpp
+ *
+ *  Created on: Mar 12, 2017
+ *      Author: nico
+ *
+ *  layout of a FASTA file split into a nucleotide stream and side streams.
+ *
+ *  Lines starting with '>' are headers; the other lines are sequence lines, whose characters
+ *  (residues) are concatenated. Residues ACGT (in either case) form the nucleotide stream, packed at
+ *  2 bits per base and compressed with Re-Pair; the grammar's alphabet is {A,C,G,T}. Lower-case
+ *  residues (soft-masking) and runs of other residues (N, IUPAC codes, ...) are recorded as runs on
+ *  the residue stream, and removed from the nucleotide stream.
+ *
+ *  The layout (stored in section RP_SECTION_FASTA) is:
+ *
+ *  	<final_newline,
+ *  	 H, (line_1, |h_1|, characters of h_1), ..., (line_H, |h_H|, characters of h_H),
+ *  	 R, (length_1, run_1), ..., (length_R, run_R),
+ *  	 M, (gap_1, length_1), ..., (gap_M, length_M),
+ *  	 E, (gap_1, length_1, char_1), ..., (gap_E, length_E, char_E)>
+ *
+ *  headers are given with their line number; the lengths of the sequence lines are run-length encoded;
+ *  lower-case runs (M) and exception runs (E) are given with the gap from the end of the previous run.
+ *
+ */
+
+#ifndef INTERNAL_FASTA_LAYOUT_HPP_
+#define INTERNAL_FASTA_LAYOUT_HPP_
+
+#include <string>
+#include <tuple>
+#include <vector>
+#include <fstream>
+
+#include "grammar.hpp"
+#include "packed_dna.hpp"
+#include "crc32c.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class fasta_layout{
+
+public:
+
+	fasta_layout(){}
+
+	/*
+	 * read the layout from the payload of section RP_SECTION_FASTA
+	 */
+	fasta_layout(vector<itype> & payload){
+
+		uint64_t i = 0;
+
+		final_newline = payload[i++];
+
+		uint64_t H = payload[i++];
+
+		for(uint64_t h=0;h<H;++h){
+
+			uint64_t line = payload[i++];
+			uint64_t l = payload[i++];
+
+			string s;
+			for(uint64_t j=0;j<l;++j) s.push_back(char(payload[i++]));
+
+			headers.push_back({line,s});
+
+		}
+
+		uint64_t R = payload[i++];
+
+		for(uint64_t r=0;r<R;++r){
+
+			itype l = payload[i++];
+			itype c = payload[i++];
+
+			line_runs.push_back({l,c});
+
+		}
+
+		uint64_t M = payload[i++];
+		uint64_t end = 0;
+
+		for(uint64_t m=0;m<M;++m){
+
+			uint64_t b = end + payload[i++];
+			end = b + payload[i++];
+
+			lower.push_back({b,end-b});
+
+		}
+
+		uint64_t E = payload[i++];
+		end = 0;
+
+		for(uint64_t e=0;e<E;++e){
+
+			uint64_t b = end + payload[i++];
+			end = b + payload[i++];
+
+			exceptions.push_back(std::make_tuple(b,end-b,uint8_t(payload[i++])));
+
+		}
+
+		assert(i == payload.size());
+
+	}
+
+	/*
+	 * split the content of stream in. Return the nucleotide stream (codes 0,1,2,3 = A,C,G,T);
+	 * the layout is recorded in this object
+	 */
+	packed_dna<itype> split(istream & in){
+
+		packed_dna<itype> P;
+
+		string line;
+		uint64_t line_number = 0;
+		uint64_t r = 0; //residues seen so far
+
+		while(std::getline(in,line)){
+
+			final_newline = not in.eof();
+
+			text_crc = crc32c::update(text_crc,(const uint8_t*)line.data(),line.size());
+			if(final_newline) text_crc = crc32c::update(text_crc,uint8_t('\n'));
+
+			text_length += line.size() + final_newline;
+
+			if(line.size() > 0 and line[0] == '>'){
+
+				headers.push_back({line_number++,line});
+				continue;
+
+			}
+
+			line_number++;
+
+			if(line_runs.size() > 0 and line_runs.back().first == line.size()){
+
+				line_runs.back().second++;
+
+			}else{
+
+				line_runs.push_back({line.size(),1});
+
+			}
+
+			for(auto ch : line){
+
+				uint8_t c = uint8_t(ch);
+
+				if(c >= 'a' and c <= 'z'){
+
+					if(lower.size() > 0 and lower.back().first + lower.back().second == r){
+
+						lower.back().second++;
+
+					}else{
+
+						lower.push_back({r,1});
+
+					}
+
+				}
+
+				uint8_t code = base_code(c);
+
+				if(code < 4){
+
+					P.push_back(code);
+					bases_crc = crc32c::update(bases_crc,base(code));
+
+				}else{
+
+					if(exceptions.size() > 0 and std::get<0>(exceptions.back()) + std::get<1>(exceptions.back()) == r and std::get<2>(exceptions.back()) == c){
+
+						std::get<1>(exceptions.back())++;
+
+					}else{
+
+						exceptions.push_back(std::make_tuple(r,1,c));
+
+					}
+
+				}
+
+				r++;
+
+			}
+
+		}
+
+		return P;
+
+	}
+
+	/*
+	 * serialize the layout (payload of section RP_SECTION_FASTA)
+	 */
+	vector<itype> serialize(){
+
+		vector<itype> payload = {final_newline, itype(headers.size())};
+
+		for(auto & h : headers){
+
+			payload.push_back(h.first);
+			payload.push_back(h.second.size());
+			for(auto c : h.second) payload.push_back(uint8_t(c));
+
+		}
+
+		payload.push_back(line_runs.size());
+
+		for(auto r : line_runs){
+
+			payload.push_back(r.first);
+			payload.push_back(r.second);
+
+		}
+
+		payload.push_back(lower.size());
+
+		uint64_t end = 0;
+
+		for(auto m : lower){
+
+			payload.push_back(m.first - end);
+			payload.push_back(m.second);
+			end = m.first + m.second;
+
+		}
+
+		payload.push_back(exceptions.size());
+
+		end = 0;
+
+		for(auto e : exceptions){
+
+			payload.push_back(std::get<0>(e) - end);
+			payload.push_back(std::get<1>(e));
+			payload.push_back(std::get<2>(e));
+			end = std::get<0>(e) + std::get<1>(e);
+
+		}
+
+		return payload;
+
+	}
+
+	/*
+	 * rebuild the FASTA file from the nucleotide stream expanded from G and write it to ofs (any object
+	 * with write(const char*, size), e.g. an ofstream)
+	 */
+	template<typename out_t>
+	void expand(grammar<itype> & G, out_t & ofs){
+
+		grammar_iterator<itype> it(&G,0,G.text().size());
+
+		string buffer;
+		uint64_t buf_size = 1000000;//1 MB buffer
+
+		uint64_t lines = headers.size();
+		for(auto r : line_runs) lines += r.second;
+
+		uint64_t h = 0; //next header
+		uint64_t run = 0; //current run of sequence lines
+		itype left = line_runs.size() > 0 ? line_runs[0].second : 0; //lines left in current run
+
+		uint64_t r = 0; //current residue
+		uint64_t m = 0; //next lower-case run
+		uint64_t e = 0; //next exception run
+
+		for(uint64_t line=0;line<lines;++line){
+
+			if(h < headers.size() and headers[h].first == line){
+
+				buffer.append(headers[h++].second);
+
+			}else{
+
+				while(left == 0) left = line_runs[++run].second;
+
+				itype len = line_runs[run].first;
+				left--;
+
+				for(itype j=0;j<len;++j){
+
+					while(e < exceptions.size() and std::get<0>(exceptions[e]) + std::get<1>(exceptions[e]) <= r) e++;
+					while(m < lower.size() and lower[m].first + lower[m].second <= r) m++;
+
+					uint8_t c;
+
+					if(e < exceptions.size() and std::get<0>(exceptions[e]) <= r){
+
+						c = std::get<2>(exceptions[e]);
+
+					}else{
+
+						assert(it.has_next());
+
+						c = it.next();
+
+						if(m < lower.size() and lower[m].first <= r) c = c - 'A' + 'a';
+
+					}
+
+					buffer.push_back(char(c));
+					r++;
+
+				}
+
+			}
+
+			if(line+1 < lines or final_newline) buffer.push_back('\n');
+
+			if(buffer.size() >= buf_size){
+
+				ofs.write(buffer.c_str(),buffer.size());
+				buffer = string();
+
+			}
+
+		}
+
+		assert(not it.has_next());
+
+		if(buffer.size()>0) ofs.write(buffer.c_str(),buffer.size());
+
+	}
+
+	/*
+	 * CRC32C and length of the FASTA file rebuilt from G (the file is not written)
+	 */
+	pair<uint32_t,uint64_t> crc32c(grammar<itype> & G){
+
+		struct crc_writer{
+
+			void write(const char * s, uint64_t n){
+
+				crc = crc32c::update(crc,(const uint8_t*)s,n);
+				length += n;
+
+			}
+
+			uint32_t crc = 0;
+			uint64_t length = 0;
+
+		};
+
+		crc_writer W;
+		expand(G,W);
+
+		return {W.crc,W.length};
+
+	}
+
+	uint64_t number_of_headers(){
+		return headers.size();
+	}
+
+	uint64_t number_of_exceptions(){
+		return exceptions.size();
+	}
+
+	/*
+	 * nucleotide of code x
+	 */
+	static uint8_t base(itype x){
+
+		assert(x < 4);
+		return "ACGT"[x];
+
+	}
+
+	//CRC32C of the nucleotide stream (as upper-case ACGT characters), computed by split
+	uint32_t bases_crc = 0;
+
+	//CRC32C and length of the FASTA file, computed by split
+	uint32_t text_crc = 0;
+	uint64_t text_length = 0;
+
+private:
+
+	/*
+	 * code of nucleotide c (0,1,2,3 = A,C,G,T, either case), or 4 if c is not a nucleotide
+	 */
+	static uint8_t base_code(uint8_t c){
+
+		switch(c){
+
+			case 'A': case 'a': return 0;
+			case 'C': case 'c': return 1;
+			case 'G': case 'g': return 2;
+			case 'T': case 't': return 3;
+			default: return 4;
+
+		}
+
+	}
+
+	itype final_newline = 0; //1 iff the last line is terminated by '\n'
+
+	//<line number, text> of the header lines
+	vector<pair<uint64_t,string> > headers;
+
+	//runs <length, number of consecutive sequence lines with that length>
+	vector<pair<itype,itype> > line_runs;
+
+	//runs <start, length> of lower-case residues
+	vector<pair<uint64_t,uint64_t> > lower;
+
+	//runs <start, length, character> of residues other than ACGT
+	vector<std::tuple<uint64_t,uint64_t,uint8_t> > exceptions;
+
+};
+
+#endif /* INTERNAL_FASTA_LAYOUT_HPP_ */
@@ -0,0 +1,466 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * grammar.hpp
+ *
+ *  Created on: Mar 2, 2017
+ *      Author: nico
+ *
+ *  in-memory Re-Pair grammar <A, G, Tc> supporting computations in the compressed domain.
+ *
+ *  Symbols 0, ..., |A|-1 are terminals (X is the ascii character A[X], or the token A[X] of the
+ *  dictionary of a word-token archive); symbol |A|+i is the i-th rule X -> G[i]. Rules are stored
+ *  bottom-up: the children of X are always smaller than X.
+ *
+ *  Supported operations:
+ *
+ *  length(X): length of the expansion of X. Complexity: O(1)
+ *  crc32c(): CRC32C of the expanded text. Complexity: O(g log n)
+ *  expand(out,b,e): write the expansion of Tc[b,...,e-1] to stream out. Complexity: O(length of the expansion)
+ *  cover(i,l): minimal sequence of symbols whose expansion is text[i,...,i+l-1]. Complexity: O(|Tc| + h), h = grammar height
+ *
+ */
+
+#ifndef INTERNAL_GRAMMAR_HPP_
+#define INTERNAL_GRAMMAR_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <ostream>
+#include <stack>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "crc32c.hpp"
+#include "rp_archive.hpp"
+#include "word_tokenizer.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class grammar{
+
+public:
+
+	using ipair = pair<itype,itype>;
+
+	grammar(){}
+
+	/*
+	 * build the grammar from alphabet, rules and compressed text (input vectors are moved)
+	 */
+	grammar(vector<itype> & A, vector<ipair> & G, vector<itype> & Tc){
+
+		this->A.swap(A);
+		this->G.swap(G);
+		this->Tc.swap(Tc);
+
+		init({});
+
+	}
+
+	/*
+	 * build the grammar stored in archive arc (its A, G and T are moved)
+	 */
+	grammar(rp_archive<itype> & arc){
+
+		A.swap(arc.A);
+		G.swap(arc.G);
+		Tc.swap(arc.T);
+
+		init(arc.has_section(RP_SECTION_TOKENS) ? word_tokenizer<itype>::dictionary_from_payload(arc.section(RP_SECTION_TOKENS)) : vector<string>());
+
+	}
+
+	/*
+	 * number of terminals
+	 */
+	itype alphabet_size(){
+		return A.size();
+	}
+
+	itype number_of_rules(){
+		return G.size();
+	}
+
+	itype number_of_symbols(){
+		return A.size() + G.size();
+	}
+
+	bool is_terminal(itype X){
+		return X < A.size();
+	}
+
+	/*
+	 * true iff terminals are tokens of a dictionary (possibly longer than one character)
+	 */
+	bool has_tokens(){
+		return tokens;
+	}
+
+	/*
+	 * ascii character associated with terminal X (byte grammars only)
+	 */
+	uint8_t terminal(itype X){
+
+		assert(is_terminal(X));
+		assert(not tokens);
+		return A[X];
+
+	}
+
+	/*
+	 * expansion of terminal X
+	 */
+	const string & terminal_string(itype X){
+
+		assert(is_terminal(X));
+		return terminals[X];
+
+	}
+
+	/*
+	 * right-hand side of rule X
+	 */
+	ipair rule(itype X){
+
+		assert(not is_terminal(X));
+		assert(X - A.size() < G.size());
+
+		return G[X - A.size()];
+
+	}
+
+	/*
+	 * length of the expansion of symbol X
+	 */
+	uint64_t length(itype X){
+
+		assert(X < number_of_symbols());
+		return len[X];
+
+	}
+
+	/*
+	 * the compressed text
+	 */
+	vector<itype> & text(){
+		return Tc;
+	}
+
+	/*
+	 * length of the expanded text
+	 */
+	uint64_t text_length(){
+		return n;
+	}
+
+	/*
+	 * write the expansion of Tc[b,...,e-1] to stream out
+	 */
+	void expand(ostream & out, uint64_t b, uint64_t e){
+
+		assert(b <= e);
+		assert(e <= Tc.size());
+
+		std::stack<itype> S;
+
+		string buffer;
+		uint64_t buf_size = 1000000;//1 MB buffer
+
+		/*
+		 * decompress Tc symbols one by one
+		 */
+		for(uint64_t i = b;i<e;++i){
+
+			S.push(Tc[i]);
+
+			while(!S.empty()){
+
+				itype X = S.top(); //get symbol
+				S.pop();//remove top
+
+				if(is_terminal(X)){
+
+					buffer.append(terminals[X]);
+
+					if(buffer.size()>=buf_size){
+
+						out.write(buffer.c_str(),buffer.size());
+						buffer = string();
+
+					}
+
+				}else{
+
+					//expand rule: X -> ab
+					auto ab = rule(X);
+
+					S.push(ab.second);
+					S.push(ab.first);
+
+				}
+
+			}
+
+		}
+
+		if(buffer.size()>0) out.write(buffer.c_str(),buffer.size());
+
+	}
+
+	/*
+	 * CRC32C of the expansion of every symbol, computed bottom-up
+	 */
+	vector<uint32_t> symbols_crc32c(){
+
+		vector<uint32_t> crc(number_of_symbols());
+
+		for(itype X = 0;X<number_of_symbols();++X){
+
+			if(is_terminal(X)){
+
+				crc[X] = crc32c::update(0,(const uint8_t*)terminals[X].data(),terminals[X].size());
+
+			}else{
+
+				auto ab = rule(X);
+				crc[X] = crc32c::combine(crc[ab.first],crc[ab.second],len[ab.second]);
+
+			}
+
+		}
+
+		return crc;
+
+	}
+
+	/*
+	 * CRC32C of the expanded text, computed without expanding it
+	 */
+	uint32_t crc32c(){
+
+		auto crc = symbols_crc32c();
+
+		uint32_t c = 0;
+		for(auto X : Tc) c = crc32c::combine(c,crc[X],len[X]);
+
+		return c;
+
+	}
+
+	/*
+	 * return the sequence of symbols whose concatenated expansions are text[i,...,i+l-1]. Tc symbols
+	 * crossing the range boundaries are split by descending the grammar, so that only O(h) symbols
+	 * are produced at each boundary. In a token grammar, the boundaries must not fall inside a token.
+	 */
+	vector<itype> cover(uint64_t i, uint64_t l){
+
+		assert(i+l <= n);
+
+		vector<itype> C;
+
+		//(symbol, begin, end) of the part of the expansion still to be covered
+		std::stack<std::tuple<itype,uint64_t,uint64_t> > S;
+
+		uint64_t start = 0; //starting position of Tc[j] in the text
+
+		for(uint64_t j=0;j<Tc.size() and start < i+l;++j){
+
+			uint64_t end = start + len[Tc[j]];
+
+			if(end > i){
+
+				uint64_t lo = std::max(i,start) - start;
+				uint64_t hi = std::min(i+l,end) - start;
+
+				S.push(std::make_tuple(Tc[j],lo,hi));
+
+				while(not S.empty()){
+
+					itype X;
+					uint64_t b, e;
+					std::tie(X,b,e) = S.top();
+					S.pop();
+
+					if(b == 0 and e == len[X]){
+
+						C.push_back(X);
+
+					}else{
+
+						auto ab = rule(X);
+						uint64_t la = len[ab.first];
+
+						//push right part first so that the left one is processed first
+						if(e > la) S.push(std::make_tuple(ab.second,std::max(b,la)-la,e-la));
+						if(b < la) S.push(std::make_tuple(ab.first,b,std::min(e,la)));
+
+					}
+
+				}
+
+			}
+
+			start = end;
+
+		}
+
+		return C;
+
+	}
+
+private:
+
+	/*
+	 * expansions of the terminals and of all symbols' lengths. If dictionary is not empty,
+	 * terminal X is the token dictionary[A[X]]
+	 */
+	void init(const vector<string> & dictionary){
+
+		tokens = not dictionary.empty();
+
+		terminals = vector<string>(A.size());
+
+		for(itype X = 0;X<A.size();++X){
+
+			if(tokens){
+
+				assert(A[X] < dictionary.size());
+				terminals[X] = dictionary[A[X]];
+
+			}else{
+
+				terminals[X] = string(1,char(A[X]));
+
+			}
+
+		}
+
+		//expansion lengths, bottom-up
+		len = vector<uint64_t>(number_of_symbols());
+
+		for(itype X = 0;X<number_of_symbols();++X){
+
+			if(is_terminal(X)){
+
+				len[X] = terminals[X].size();
+
+			}else{
+
+				auto ab = rule(X);
+
+				assert(ab.first < X && ab.second < X);
+
+				len[X] = len[ab.first] + len[ab.second];
+
+			}
+
+		}
+
+		n = 0;
+		for(auto X : this->Tc) n += len[X];
+
+	}
+
+	vector<itype> A;
+	vector<ipair> G;
+	vector<itype> Tc;
+
+	bool tokens = false; //true iff terminals are dictionary tokens
+	vector<string> terminals; //expansion of each terminal
+
+	//expansion lengths
+	vector<uint64_t> len;
+
+	//expanded text length
+	uint64_t n = 0;
+
+};
+
+/*
+ * left-to-right expansion of Tc[b,...,e-1], one character at a time.
+ * Uses O(h) words of memory, h = grammar height
+ */
+template<typename itype = uint32_t>
+class grammar_iterator{
+
+public:
+
+	grammar_iterator(grammar<itype> * G, uint64_t b, uint64_t e){
+
+		assert(b <= e);
+		assert(e <= G->text().size());
+
+		this->G = G;
+		this->i = b;
+		this->e = e;
+
+	}
+
+	bool has_next(){
+
+		return (w != nullptr and off < w->size()) or not S.empty() or i < e;
+
+	}
+
+	/*
+	 * return next character of the expansion
+	 */
+	uint8_t next(){
+
+		assert(has_next());
+
+		//characters of the current terminal still to be returned
+		if(w != nullptr and off < w->size()) return uint8_t((*w)[off++]);
+
+		if(S.empty()) S.push_back(G->text()[i++]);
+
+		while(not G->is_terminal(S.back())){
+
+			auto ab = G->rule(S.back());
+			S.pop_back();
+
+			S.push_back(ab.second);
+			S.push_back(ab.first);
+
+		}
+
+		itype X = S.back();
+		S.pop_back();
+
+		w = &G->terminal_string(X);
+		off = 0;
+
+		return uint8_t((*w)[off++]);
+
+	}
+
+private:
+
+	grammar<itype> * G;
+
+	uint64_t i; //next Tc position to expand
+	uint64_t e;
+
+	vector<itype> S; //symbols still to be expanded
+
+	const string * w = nullptr; //expansion of the last terminal
+	uint64_t off = 0; //next character of w
+
+};
+
+#endif /* INTERNAL_GRAMMAR_HPP_ */
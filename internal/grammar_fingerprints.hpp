@@ -0,0 +1,219 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * grammar_fingerprints.hpp
+ *
+ *  Created on: Mar 3, 2017
+ *      Author: nico
+ *
+ *  Karp-Rabin fingerprints of the expansions of a grammar's symbols, modulo the prime 2^61-1.
+ *  The fingerprint of a string S[0..l-1] is  sum_i (S[i]+1) * base^(l-1-i).
+ *
+ *  Fingerprints are computed bottom-up on the rules: kr(XY) = kr(X) * base^|Y| + kr(Y).
+ *  Prefix sums of lengths and fingerprints are stored for the compressed text, so that the
+ *  fingerprint of any text prefix is computed with a binary search on Tc followed by a
+ *  root-to-leaf descent in the grammar. Two grammars can be compared only if they
+ *  use the same base. grammar_t is grammar<itype> or succinct_grammar<itype>.
+ *
+ *  Supported operations:
+ *
+ *  prefix(l): fingerprint of the text prefix of length l. Complexity: O(log |Tc| + h), h = grammar height
+ *
+ */
+
+#ifndef INTERNAL_GRAMMAR_FINGERPRINTS_HPP_
+#define INTERNAL_GRAMMAR_FINGERPRINTS_HPP_
+
+#include <algorithm>
+
+#include "grammar.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t, typename grammar_t = grammar<itype> >
+class grammar_fingerprints{
+
+public:
+
+	static const uint64_t PRIME = (uint64_t(1) << 61) - 1;
+
+	grammar_fingerprints(grammar_t * G, uint64_t base){
+
+		this->G = G;
+		this->base = base % PRIME;
+
+		auto s = G->number_of_symbols();
+
+		kr = vector<uint64_t>(s);
+		pw = vector<uint64_t>(s);
+
+		for(itype X = 0;X<s;++X){
+
+			if(G->is_terminal(X)){
+
+				kr[X] = string_kr(G->terminal_string(X),G->length(X));
+				pw[X] = power(G->length(X));
+
+			}else{
+
+				auto ab = G->rule(X);
+
+				kr[X] = add(mul(kr[ab.first],pw[ab.second]),kr[ab.second]);
+				pw[X] = mul(pw[ab.first],pw[ab.second]);
+
+			}
+
+		}
+
+		auto & Tc = G->text();
+
+		cum_len = vector<uint64_t>(Tc.size()+1,0);
+		cum_kr = vector<uint64_t>(Tc.size()+1,0);
+
+		for(uint64_t i=0;i<Tc.size();++i){
+
+			cum_len[i+1] = cum_len[i] + G->length(Tc[i]);
+			cum_kr[i+1] = add(mul(cum_kr[i],pw[Tc[i]]),kr[Tc[i]]);
+
+		}
+
+	}
+
+	/*
+	 * fingerprint of the expansion of symbol X
+	 */
+	uint64_t symbol(itype X){
+
+		return kr[X];
+
+	}
+
+	/*
+	 * fingerprint of the text prefix of length l <= text length
+	 */
+	uint64_t prefix(uint64_t l){
+
+		assert(l <= G->text_length());
+
+		auto & Tc = G->text();
+
+		//last i such that cum_len[i] <= l
+		uint64_t i = (std::upper_bound(cum_len.begin(),cum_len.end(),l) - cum_len.begin()) - 1;
+
+		uint64_t f = cum_kr[i];
+		uint64_t rem = l - cum_len[i]; //characters still to be covered inside Tc[i]
+
+		itype X = rem > 0 ? Tc[i] : 0;
+
+		while(rem > 0){
+
+			if(G->is_terminal(X)){
+
+				assert(rem <= G->length(X));
+
+				//a prefix of the terminal's expansion (a token, in word-token grammars)
+				f = add(mul(f,power(rem)),string_kr(G->terminal_string(X),rem));
+				rem = 0;
+
+			}else{
+
+				auto ab = G->rule(X);
+				uint64_t la = G->length(ab.first);
+
+				if(rem >= la){
+
+					//the left child is entirely inside the prefix
+					f = add(mul(f,pw[ab.first]),kr[ab.first]);
+					rem -= la;
+					X = ab.second;
+
+				}else{
+
+					X = ab.first;
+
+				}
+
+			}
+
+		}
+
+		return f;
+
+	}
+
+private:
+
+	/*
+	 * fingerprint of the first l characters of w
+	 */
+	uint64_t string_kr(const string & w, uint64_t l){
+
+		uint64_t f = 0;
+		for(uint64_t i=0;i<l;++i) f = add(mul(f,base),uint64_t(uint8_t(w[i])) + 1);
+
+		return f;
+
+	}
+
+	/*
+	 * base^e
+	 */
+	uint64_t power(uint64_t e){
+
+		uint64_t r = 1;
+		uint64_t b = base;
+
+		for(;e>0;e >>= 1){
+
+			if(e & 1) r = mul(r,b);
+			b = mul(b,b);
+
+		}
+
+		return r;
+
+	}
+
+	uint64_t mul(uint64_t a, uint64_t b){
+
+		__uint128_t x = __uint128_t(a) * b;
+
+		uint64_t r = uint64_t(x & PRIME) + uint64_t(x >> 61);
+
+		return r >= PRIME ? r - PRIME : r;
+
+	}
+
+	uint64_t add(uint64_t a, uint64_t b){
+
+		uint64_t r = a + b;
+
+		return r >= PRIME ? r - PRIME : r;
+
+	}
+
+	grammar_t * G;
+
+	uint64_t base;
+
+	vector<uint64_t> kr; //fingerprint of each symbol
+	vector<uint64_t> pw; //base^length of each symbol
+
+	vector<uint64_t> cum_len; //cum_len[i] = length of the expansion of Tc[0,...,i-1]
+	vector<uint64_t> cum_kr; //cum_kr[i] = fingerprint of the expansion of Tc[0,...,i-1]
+
+};
+
+#endif /* INTERNAL_GRAMMAR_FINGERPRINTS_HPP_ */
@@ -0,0 +1,529 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * grammar_index.hpp
+ *
+ *  Created on: Mar 18, 2017
+ *      Author: nico
+ *
+ *  grammar self-index: locates all occurrences of a pattern in a grammar's text without expanding it.
+ *
+ *  A boundary is either the point between the two children of a rule X -> AB, or the point between
+ *  two consecutive symbols Tc[i], Tc[i+1] of the compressed text. Its left string is exp(A) (resp.
+ *  exp(Tc[i])) and its right string is exp(B) (resp. the text suffix starting at Tc[i+1]).
+ *
+ *  An occurrence of P (|P| = m >= 2) not inside a terminal is primary for exactly one boundary: the one of
+ *  the lowest rule containing it, or the first Tc boundary it crosses. If it crosses the boundary after
+ *  its first j characters, P[0..j-1] is a suffix of the left string and P[j..m-1] a prefix of the right
+ *  string. Boundaries are sorted by reversed left string (x order) and by right string (y order), so for
+ *  every split j the candidates are the points of a 2D range, found with binary searches (extracting
+ *  the boundary strings from the grammar). The occurrences of a rule are then found by following the
+ *  rule's parents up to the compressed text (secondary occurrences).
+ *
+ *  Boundaries are sorted on the first KEY characters of their strings: parts longer than KEY characters
+ *  select a superset of the candidates, which are verified by extraction.
+ *
+ *  locate(P): complexity O(m (log g (h + m) + r) + occ h) in the worst case, g = grammar size,
+ *  h = grammar height, r = size of the smaller of the two ranges of a split.
+ *
+ *  The orders are stored in a sidecar file (packed integers) as
+ *
+ *  	<VERSION, KEY, alphabet size, rules, |Tc|, text length, B, x order (B), y rank of each x-ordered boundary (B)>
+ *
+ *  where B is the number of boundaries. Rule boundaries are numbered 0, ..., rules-1 and Tc boundaries
+ *  rules, ..., B-1.
+ *
+ *  grammar_t is grammar<itype> or succinct_grammar<itype> (smaller, slower rule access).
+ *
+ */
+
+#ifndef INTERNAL_GRAMMAR_INDEX_HPP_
+#define INTERNAL_GRAMMAR_INDEX_HPP_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "grammar.hpp"
+#include "packed_gamma_file3.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t, typename grammar_t = grammar<itype> >
+class grammar_index{
+
+public:
+
+	static const uint64_t VERSION = 1;
+	static const uint64_t KEY = 32;
+
+	/*
+	 * prepare an index of the text of G. The boundary orders must be then computed
+	 * with build() or loaded with load()
+	 */
+	grammar_index(grammar_t * G){
+
+		this->G = G;
+
+		sigma = G->alphabet_size();
+		R = G->number_of_rules();
+
+		auto & Tc = G->text();
+
+		B = R + (Tc.size() > 0 ? Tc.size()-1 : 0);
+
+		start = vector<uint64_t>(Tc.size()+1,0);
+		for(uint64_t i=0;i<Tc.size();++i) start[i+1] = start[i] + G->length(Tc[i]);
+
+		//parents (2*Y + 1 if the symbol is Y's right child) and Tc occurrences of every symbol
+		itype s = G->number_of_symbols();
+
+		par_begin = vector<uint64_t>(s+1,0);
+		tc_begin = vector<uint64_t>(s+1,0);
+
+		for(itype r=0;r<R;++r){
+
+			auto ab = G->rule(sigma+r);
+
+			par_begin[ab.first+1]++;
+			par_begin[ab.second+1]++;
+
+		}
+
+		for(uint64_t i=0;i<Tc.size();++i) tc_begin[Tc[i]+1]++;
+
+		for(itype X=0;X<s;++X){
+
+			par_begin[X+1] += par_begin[X];
+			tc_begin[X+1] += tc_begin[X];
+
+		}
+
+		par = vector<itype>(par_begin[s]);
+		tc = vector<itype>(tc_begin[s]);
+
+		{
+			auto next = par_begin;
+
+			for(itype r=0;r<R;++r){
+
+				auto ab = G->rule(sigma+r);
+
+				par[next[ab.first]++] = 2*(sigma+r);
+				par[next[ab.second]++] = 2*(sigma+r)+1;
+
+			}
+
+			next = tc_begin;
+
+			for(uint64_t i=0;i<Tc.size();++i) tc[next[Tc[i]]++] = i;
+		}
+
+	}
+
+	/*
+	 * sort the boundaries. Time O(g (KEY + log g KEY)), space O(g KEY) characters
+	 */
+	void build(){
+
+		auto & Tc = G->text();
+		itype s = G->number_of_symbols();
+
+		//prefixes and suffixes of length (at most) KEY
+		vector<string> pre(s);
+		vector<string> suf(s);
+
+		for(itype X = 0;X<s;++X){
+
+			if(G->is_terminal(X)){
+
+				const string & w = G->terminal_string(X);
+
+				pre[X] = w.substr(0,KEY);
+				suf[X] = w.substr(w.size() - std::min(uint64_t(w.size()),KEY));
+
+			}else{
+
+				auto ab = G->rule(X);
+
+				pre[X] = (pre[ab.first] + pre[ab.second]).substr(0,KEY);
+
+				string t = suf[ab.first] + suf[ab.second];
+				suf[X] = t.substr(t.size() - std::min(uint64_t(t.size()),KEY));
+
+			}
+
+		}
+
+		vector<string> left(B);
+		vector<string> right(B);
+
+		for(itype r=0;r<R;++r){
+
+			auto ab = G->rule(sigma+r);
+
+			left[r] = string(suf[ab.first].rbegin(),suf[ab.first].rend());
+			right[r] = pre[ab.second];
+
+		}
+
+		//right strings of the Tc boundaries, from the last one
+		string t;
+
+		for(uint64_t i=B;i>R;--i){
+
+			uint64_t j = i-1-R; //boundary between Tc[j] and Tc[j+1]
+
+			t = (pre[Tc[j+1]] + t).substr(0,KEY);
+
+			left[i-1] = string(suf[Tc[j]].rbegin(),suf[Tc[j]].rend());
+			right[i-1] = t;
+
+		}
+
+		pre = {};
+		suf = {};
+
+		x_order = vector<itype>(B);
+		y_order = vector<itype>(B);
+
+		for(itype b=0;b<B;++b) x_order[b] = y_order[b] = b;
+
+		std::sort(x_order.begin(),x_order.end(),[&](itype a, itype b){ return left[a] < left[b]; });
+		std::sort(y_order.begin(),y_order.end(),[&](itype a, itype b){ return right[a] < right[b]; });
+
+		ranks();
+
+	}
+
+	/*
+	 * store the boundary orders to file
+	 */
+	void store(string filename){
+
+		packed_gamma_file3<itype> out(filename);
+
+		for(auto x : header()) out.push_back(x);
+
+		out.push_back(B);
+		out.end_stream();
+
+		for(auto b : x_order) out.push_back(b);
+		out.end_stream();
+
+		for(auto y : y_rank_of_x) out.push_back(y);
+
+		out.close();
+
+	}
+
+	/*
+	 * load the boundary orders from file. Return false if the file was not built from this grammar
+	 */
+	bool load(string filename){
+
+		if(not ifstream(filename).good()) return false;
+
+		packed_gamma_file3<itype> in(filename, false);
+
+		for(auto x : header()) if(in.read() != x) return false;
+
+		if(in.read() != B) return false;
+
+		x_order = vector<itype>(B);
+		y_rank_of_x = vector<itype>(B);
+
+		for(auto & b : x_order) b = in.read();
+		for(auto & y : y_rank_of_x) y = in.read();
+
+		y_order = vector<itype>(B);
+
+		for(itype k=0;k<B;++k) y_order[y_rank_of_x[k]] = x_order[k];
+
+		ranks();
+
+		return true;
+
+	}
+
+	uint64_t number_of_boundaries(){
+		return B;
+	}
+
+	/*
+	 * sorted text positions of the occurrences of P
+	 */
+	vector<uint64_t> locate(const string & P){
+
+		vector<uint64_t> occ;
+
+		uint64_t m = P.size();
+
+		if(m == 0) return occ;
+
+		//occurrences inside terminals (all occurrences if m = 1 and terminals are characters)
+		for(itype X=0;X<sigma;++X){
+
+			const string & w = G->terminal_string(X);
+
+			for(auto o = w.find(P);o != string::npos;o = w.find(P,o+1)) report(X,o,occ);
+
+		}
+
+		for(uint64_t j=1;j<m;++j){
+
+			string l(P.rend()-j,P.rend()); //P[0..j-1] reversed
+			string r = P.substr(j);
+
+			bool verify = l.size() > KEY or r.size() > KEY;
+
+			auto xr = range(x_order, l.substr(0,KEY), true);
+			auto yr = range(y_order, r.substr(0,KEY), false);
+
+			auto candidate = [&](itype b){
+
+				if(verify and (left_string(b,j) != l or right_string(b,m-j) != r)) return;
+
+				if(b < R){
+
+					itype X = sigma+b;
+					report(X, G->length(G->rule(X).first)-j, occ);
+
+				}else{
+
+					occ.push_back(start[b-R+1]-j);
+
+				}
+
+			};
+
+			if(xr.second-xr.first <= yr.second-yr.first){
+
+				for(itype k=xr.first;k<xr.second;++k){
+
+					if(y_rank_of_x[k] >= yr.first and y_rank_of_x[k] < yr.second) candidate(x_order[k]);
+
+				}
+
+			}else{
+
+				for(itype k=yr.first;k<yr.second;++k){
+
+					if(x_rank_of_y[k] >= xr.first and x_rank_of_y[k] < xr.second) candidate(y_order[k]);
+
+				}
+
+			}
+
+		}
+
+		std::sort(occ.begin(),occ.end());
+
+		return occ;
+
+	}
+
+private:
+
+	vector<uint64_t> header(){
+
+		return {VERSION, KEY, sigma, R, G->text().size(), G->text_length()};
+
+	}
+
+	/*
+	 * compute the inverse permutations linking the two orders
+	 */
+	void ranks(){
+
+		vector<itype> y_rank(B);
+		for(itype k=0;k<B;++k) y_rank[y_order[k]] = k;
+
+		y_rank_of_x = vector<itype>(B);
+		x_rank_of_y = vector<itype>(B);
+
+		for(itype k=0;k<B;++k){
+
+			y_rank_of_x[k] = y_rank[x_order[k]];
+			x_rank_of_y[y_rank_of_x[k]] = k;
+
+		}
+
+	}
+
+	/*
+	 * range of positions k of order (x_order if left = true, y_order otherwise) such that the boundary
+	 * string of order[k] starts with q
+	 */
+	pair<itype,itype> range(const vector<itype> & order, const string & q, bool left){
+
+		auto str = [&](itype b){ return left ? left_string(b,q.size()) : right_string(b,q.size()); };
+
+		itype lo = std::partition_point(order.begin(),order.end(),[&](itype b){ return str(b) < q; }) - order.begin();
+		itype hi = std::partition_point(order.begin()+lo,order.end(),[&](itype b){ return str(b) <= q; }) - order.begin();
+
+		return {lo,hi};
+
+	}
+
+	/*
+	 * last (at most) l characters of the left string of boundary b, reversed
+	 */
+	string left_string(itype b, uint64_t l){
+
+		return suffix(b < R ? G->rule(sigma+b).first : G->text()[b-R], l);
+
+	}
+
+	/*
+	 * first (at most) l characters of the right string of boundary b
+	 */
+	string right_string(itype b, uint64_t l){
+
+		if(b < R) return prefix(G->rule(sigma+b).second, l);
+
+		auto & Tc = G->text();
+
+		string s;
+
+		for(uint64_t i=b-R+1;i<Tc.size() and s.size()<l;++i) s.append(prefix(Tc[i],l-s.size()));
+
+		return s;
+
+	}
+
+	/*
+	 * first (at most) l characters of exp(X)
+	 */
+	string prefix(itype X, uint64_t l){
+
+		string s;
+		vector<itype> S = {X};
+
+		while(not S.empty() and s.size()<l){
+
+			itype Y = S.back();
+			S.pop_back();
+
+			if(G->is_terminal(Y)){
+
+				s.append(G->terminal_string(Y).substr(0,l-s.size()));
+
+			}else{
+
+				auto ab = G->rule(Y);
+
+				S.push_back(ab.second);
+				S.push_back(ab.first);
+
+			}
+
+		}
+
+		return s;
+
+	}
+
+	/*
+	 * last (at most) l characters of exp(X), reversed
+	 */
+	string suffix(itype X, uint64_t l){
+
+		string s;
+		vector<itype> S = {X};
+
+		while(not S.empty() and s.size()<l){
+
+			itype Y = S.back();
+			S.pop_back();
+
+			if(G->is_terminal(Y)){
+
+				const string & w = G->terminal_string(Y);
+
+				for(auto c = w.rbegin();c != w.rend() and s.size()<l;++c) s.push_back(*c);
+
+			}else{
+
+				auto ab = G->rule(Y);
+
+				S.push_back(ab.first);
+				S.push_back(ab.second);
+
+			}
+
+		}
+
+		return s;
+
+	}
+
+	/*
+	 * report the occurrences of an occurrence at offset o of exp(X), following X's parents up to Tc
+	 */
+	void report(itype X, uint64_t o, vector<uint64_t> & occ){
+
+		vector<pair<itype,uint64_t> > S = {{X,o}};
+
+		while(not S.empty()){
+
+			auto Yo = S.back();
+			S.pop_back();
+
+			itype Y = Yo.first;
+
+			for(uint64_t k=tc_begin[Y];k<tc_begin[Y+1];++k) occ.push_back(start[tc[k]] + Yo.second);
+
+			for(uint64_t k=par_begin[Y];k<par_begin[Y+1];++k){
+
+				itype Z = par[k]/2;
+				uint64_t off = par[k]%2 == 0 ? Yo.second : G->length(G->rule(Z).first) + Yo.second;
+
+				S.push_back({Z,off});
+
+			}
+
+		}
+
+	}
+
+	grammar_t * G = nullptr;
+
+	itype sigma = 0;
+	itype R = 0; //number of rules
+	itype B = 0; //number of boundaries
+
+	//start[i] = text position of Tc[i]
+	vector<uint64_t> start;
+
+	//parents and Tc positions of every symbol (CSR)
+	vector<uint64_t> par_begin;
+	vector<itype> par;
+	vector<uint64_t> tc_begin;
+	vector<itype> tc;
+
+	//boundaries sorted by reversed left string and by right string
+	vector<itype> x_order;
+	vector<itype> y_order;
+
+	vector<itype> y_rank_of_x;
+	vector<itype> x_rank_of_y;
+
+};
+
+template<typename itype, typename grammar_t> const uint64_t grammar_index<itype,grammar_t>::VERSION;
+template<typename itype, typename grammar_t> const uint64_t grammar_index<itype,grammar_t>::KEY;
+
+#endif /* INTERNAL_GRAMMAR_INDEX_HPP_ */
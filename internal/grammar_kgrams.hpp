@@ -0,0 +1,196 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * grammar_kgrams.hpp
+ *
+ *  Created on: Mar 16, 2017
+ *      Author: nico
+ *
+ *  frequencies of the k-grams (substrings of length k) of a grammar's text, computed without
+ *  expanding the text.
+ *
+ *  Every k-gram occurrence is charged to the lowest symbol of the derivation tree containing it:
+ *  a terminal (if its string is at least k characters long), a rule X -> AB (if the occurrence
+ *  crosses the boundary between A and B) or the compressed text (if it crosses the boundary between
+ *  two consecutive Tc symbols). The k-grams crossing the boundary of X -> AB lie in
+ *  suffix(A, k-1) + prefix(B, k-1), and are counted occ(X) times, occ(X) being the number of
+ *  occurrences of X in the derivation tree. Prefixes and suffixes of length k-1 are computed
+ *  bottom-up on the rules.
+ *
+ *  Complexity: O(g k) windows of length k are hashed, g = grammar size. Space: O(g k) characters
+ *  plus the distinct k-grams.
+ *
+ */
+
+#ifndef INTERNAL_GRAMMAR_KGRAMS_HPP_
+#define INTERNAL_GRAMMAR_KGRAMS_HPP_
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class grammar_kgrams{
+
+public:
+
+	grammar_kgrams(grammar<itype> * G, uint64_t k){
+
+		assert(k > 0);
+
+		this->k = k;
+
+		auto s = G->number_of_symbols();
+
+		//number of occurrences of every symbol in the derivation tree
+		vector<uint64_t> occ(s,0);
+
+		for(auto X : G->text()) occ[X]++;
+
+		for(itype X = s;X > G->alphabet_size();--X){
+
+			auto ab = G->rule(X-1);
+
+			occ[ab.first] += occ[X-1];
+			occ[ab.second] += occ[X-1];
+
+		}
+
+		//prefixes and suffixes of length (at most) k-1
+		vector<string> pre(s);
+		vector<string> suf(s);
+
+		for(itype X = 0;X<s;++X){
+
+			if(G->is_terminal(X)){
+
+				const string & w = G->terminal_string(X);
+
+				count_windows(w,0,w.size(),occ[X]);
+
+				pre[X] = head(w);
+				suf[X] = tail(w);
+
+			}else{
+
+				auto ab = G->rule(X);
+
+				count_windows(suf[ab.first] + pre[ab.second],0,suf[ab.first].size(),occ[X]);
+
+				pre[X] = head(pre[ab.first] + pre[ab.second]);
+				suf[X] = tail(suf[ab.first] + suf[ab.second]);
+
+			}
+
+		}
+
+		//k-grams crossing the boundaries of the compressed text's symbols
+		string last; //last k-1 characters of the text expanded so far
+
+		for(auto X : G->text()){
+
+			count_windows(last + pre[X],0,last.size(),1);
+
+			last = G->length(X) >= k-1 ? suf[X] : tail(last + pre[X]);
+
+		}
+
+		for(auto & c : counts) total_count += c.second;
+
+	}
+
+	/*
+	 * number of occurrences of w (|w| = k) in the text
+	 */
+	uint64_t count(const string & w){
+
+		assert(w.size() == k);
+
+		auto it = counts.find(w);
+
+		return it == counts.end() ? 0 : it->second;
+
+	}
+
+	/*
+	 * the (at most) N most frequent k-grams with their frequencies, by decreasing frequency (ties broken
+	 * lexicographically)
+	 */
+	vector<pair<string,uint64_t> > top(uint64_t N){
+
+		vector<pair<string,uint64_t> > v(counts.begin(),counts.end());
+
+		N = std::min(N,uint64_t(v.size()));
+
+		std::partial_sort(v.begin(),v.begin()+N,v.end(),[](const pair<string,uint64_t> & a, const pair<string,uint64_t> & b){
+
+			return a.second > b.second or (a.second == b.second and a.first < b.first);
+
+		});
+
+		v.resize(N);
+
+		return v;
+
+	}
+
+	/*
+	 * number of distinct k-grams
+	 */
+	uint64_t distinct(){
+		return counts.size();
+	}
+
+	/*
+	 * number of k-gram occurrences (n-k+1 if the text length n is at least k)
+	 */
+	uint64_t total(){
+		return total_count;
+	}
+
+private:
+
+	/*
+	 * add mult to the frequency of the k-grams of s starting at positions b, ..., e-1
+	 */
+	void count_windows(const string & s, uint64_t b, uint64_t e, uint64_t mult){
+
+		if(mult == 0) return;
+
+		for(uint64_t i=b;i<e and i+k <= s.size();++i) counts[s.substr(i,k)] += mult;
+
+	}
+
+	string head(const string & s){
+		return s.substr(0,std::min(uint64_t(s.size()),k-1));
+	}
+
+	string tail(const string & s){
+		return s.substr(s.size() - std::min(uint64_t(s.size()),k-1));
+	}
+
+	uint64_t k = 0;
+	uint64_t total_count = 0;
+
+	unordered_map<string,uint64_t> counts;
+
+};
+
+#endif /* INTERNAL_GRAMMAR_KGRAMS_HPP_ */
@@ -28,6 +28,8 @@
  *
  *  - H: sigma x sigma -> int is a hash table pointing at elements in B
  *
+ *  Internally, pairs are stored as packed 64-bit keys (see pair_key.hpp)
+ *
  *  Supported operations (all amortized constant time)
  *
  *  operator[ab]: return triple <P_ab, L_ab, F_ab> relative to pair ab
@@ -47,6 +49,7 @@
 #include <ll_vec.hpp>
 #include <unordered_map>
 #include <ll_el.hpp>
+#include <pair_key.hpp>
 #include <algorithm>
 
 using namespace std;
@@ -75,8 +78,7 @@ public:
 	};
 
 	//value of hash elements: pair <frequency, offset>. The element is accessed as F[frequency].list[offset]
-	using hash_t = std::unordered_map<cpair, h_el_t>;
-	//using hash_t = dense_hash_map<cpair, h_el_t>;
+	using hash_t = std::unordered_map<pair_key_t, h_el_t, pair_key_hash>;
 
 	using int_type = itype;
 	using char_type = ctype;
@@ -103,7 +105,7 @@ public:
 		this->max_size = ~(itype(0)); //for now, unlimited max size
 
 		//F = vector<ll_type>(max_freq+1);
-		F = vector<vector<cpair> >(max_freq+1,vector<cpair>(0));
+		F = vector<vector<pair_key_t> >(max_freq+1,vector<pair_key_t>(0));
 		F_idx = vector<itype>(max_freq+1,0);
 		F_size = vector<itype>(max_freq+1,0);
 		is_sorted = vector<bool>(max_freq+1,false);
@@ -121,7 +123,7 @@ public:
 		assert(max_size>0);
 		assert(contains(ab));
 
-		auto e = H[ab];
+		auto e = H[pack_pair(ab.first,ab.second)];
 		return {e.P_ab, e.L_ab, e.F_ab};
 
 	}
@@ -152,9 +154,9 @@ public:
 		assert(MAX<F.size());
 		assert(MAX>1);
 
-		cpair ab = NULLPAIR;
+		pair_key_t ab = NULLKEY;
 
-		while(ab == NULLPAIR and MAX > 1){
+		while(ab == NULLKEY and MAX > 1){
 
 			assert(F_idx[MAX] <= F[MAX].size());
 
@@ -164,9 +166,9 @@ public:
 				if(F_idx[MAX] == 0 and not is_sorted[MAX]){
 
 					std::sort(F[MAX].begin(),F[MAX].end(),
-							[](const cpair & a, const cpair & b) -> bool
+							[](pair_key_t a, pair_key_t b) -> bool
 							{
-							    return std::max(a.first,a.second) < std::max(b.first,b.second);
+							    return std::max(key_first(a),key_second(a)) < std::max(key_first(b),key_second(b));
 							});
 
 					is_sorted[MAX] = true;
@@ -174,14 +176,13 @@ public:
 				}
 
 				//if the pair is in the hash with this frequency, we found the MAX.
-				cpair ab1 = F[MAX][F_idx[MAX]];
+				pair_key_t ab1 = F[MAX][F_idx[MAX]];
 
-				if(contains(ab1) && at(ab1).F_ab == MAX){
+				auto it = H.find(ab1);
 
-					ab = ab1;
+				if(it != H.end() && it->second.F_ab == MAX){
 
-					assert(contains(ab));
-					assert(ab != NULLPAIR);
+					ab = ab1;
 
 				}else{//else: increment index in the list (pair is not in the hash OR it is but with a different frequency)
 
@@ -199,11 +200,13 @@ public:
 
 		if(MAX<2) return NULLPAIR;
 
-		assert(ab != NULLPAIR);
-		assert(contains(ab));
-		assert(at(ab).F_ab == MAX);
+		cpair max_pair = unpack_pair<ctype>(ab);
 
-		return ab;
+		assert(max_pair != NULLPAIR);
+		assert(contains(max_pair));
+		assert(at(max_pair).F_ab == MAX);
+
+		return max_pair;
 
 	}
 
@@ -212,8 +215,9 @@ public:
 		assert(contains(ab));
 		assert(max_size>0);
 
-		h_el_t el = H[ab];
-		H.erase(ab);//remove pair from hash
+		auto it = H.find(pack_pair(ab.first,ab.second));
+		h_el_t el = it->second;
+		H.erase(it);//remove pair from hash
 
 		assert(F_size[el.F_ab]>0);
 		F_size[el.F_ab]--;
@@ -231,7 +235,7 @@ public:
 
 		assert(max_size>0);
 
-		return ab == NULLPAIR ? false : H.count(ab) == 1;
+		return ab == NULLPAIR ? false : H.count(pack_pair(ab.first,ab.second)) == 1;
 
 	}
 
@@ -243,7 +247,8 @@ public:
 		assert(contains(ab));
 		assert(max_size>0);
 
-		h_el_t & el = H[ab];
+		pair_key_t k = pack_pair(ab.first,ab.second);
+		h_el_t & el = H[k];
 
 		assert(el.F_ab > 0);
 		assert(el.F_ab < F.size());
@@ -251,7 +256,7 @@ public:
 
 		F_size[el.F_ab]--;
 		el.F_ab--; //decrease frequency
-		F[el.F_ab].push_back(ab); //now insert the element in its list
+		F[el.F_ab].push_back(k); //now insert the element in its list
 		F_size[el.F_ab]++;
 
 		assert(contains(ab));
@@ -272,15 +277,19 @@ public:
 
 		itype F_ab = el.F_ab;
 
-		//must insert only pairs with frequency smaller than MAX
-		assert(F_ab <= MAX);
 		assert(F_ab < F.size());
+
+		//with exact frequencies, new pairs are never more frequent than MAX. A pair found by a relaxed
+		//synchronization (see re_pair::sync_ratio) can be: the maximum is searched again from F_ab
+		if(F_ab > MAX) MAX = F_ab;
 		assert(not contains(el.ab));
 		assert(max_size>0);
 
-		F[F_ab].push_back(el.ab); //insert ab in its list
+		pair_key_t k = pack_pair(el.ab.first,el.ab.second);
+
+		F[F_ab].push_back(k); //insert ab in its list
 		F_size[F_ab]++;
-		H.insert({el.ab,{el.P_ab,el.L_ab,F_ab}}); //insert ab in the hash
+		H.insert({k,{el.P_ab,el.L_ab,F_ab}}); //insert ab in the hash
 
 		current_size++;
 		peak_size = current_size > peak_size ? current_size : peak_size;
@@ -306,14 +315,11 @@ public:
 		assert(max_size>0);
 		assert(el.F_ab < F.size());
 
-		auto & e = H[el.ab];
+		auto & e = H[pack_pair(el.ab.first,el.ab.second)];
 		e.P_ab = el.P_ab;
 		e.L_ab = el.L_ab;
 
 		assert(e.F_ab == el.F_ab);
-		assert(H[el.ab].P_ab == el.P_ab);
-		assert(H[el.ab].L_ab == el.L_ab);
-		assert(H[el.ab].F_ab == el.F_ab);
 		assert(el.F_ab >= 2);
 
 	}
@@ -338,11 +344,13 @@ private:
 
 		assert(max_size>0);
 
-		vector<cpair> new_list;
+		vector<pair_key_t> new_list;
 
 		for(auto ab : F[f]){
 
-			if(contains(ab) && at(ab).F_ab == f){
+			auto it = H.find(ab);
+
+			if(it != H.end() && it->second.F_ab == f){
 
 				new_list.push_back(ab);
 
@@ -367,7 +375,7 @@ private:
 
 	//vector<ll_type> F;
 
-	vector<vector<cpair> > F;
+	vector<vector<pair_key_t> > F;
 	vector<itype> F_idx;
 	vector<itype> F_size;
 	vector<bool> is_sorted;
@@ -376,7 +384,6 @@ private:
 
 	const itype null = ~ctype(0);
 	const cpair NULLPAIR = {null,null};
-	const cpair VOIDPAIR = {null-1,null-1};
 
 };
 
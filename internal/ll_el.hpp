@@ -25,13 +25,16 @@
 #include <cassert>
 #include <functional>
 
+#include "pair_key.hpp"
+
 using namespace std;
 
 #ifndef INTERNAL_LL_EL_HPP_
 #define INTERNAL_LL_EL_HPP_
 
 /*
- * define hash functions for pairs of (32-bits/64-bits) integers
+ * define hash functions for pairs of (32-bits/64-bits) integers. XORing the hashes of the two
+ * components would send ab and ba (and all pairs aa) to the same bucket: mix the packed key instead
  */
 namespace std{
 
@@ -40,7 +43,7 @@ struct hash<pair<uint32_t,uint32_t> >{
 
 	std::size_t operator()(const pair<uint32_t,uint32_t>& k) const{
 
-		return hash<uint32_t>()(k.first) ^ hash<uint32_t>()(k.second);
+		return pair_key_hash()(pack_pair(k.first,k.second));
 
 	}
 
@@ -51,7 +54,7 @@ struct hash<pair<uint64_t,uint64_t> >{
 
 	std::size_t operator()(const pair<uint64_t,uint64_t>& k) const{
 
-		return hash<uint64_t>()(k.first) ^ hash<uint64_t>()(k.second);
+		return pair_key_hash()(pair_key_hash()(k.first) + k.second);
 
 	}
 
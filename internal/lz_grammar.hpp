@@ -0,0 +1,705 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * lz_grammar.hpp
+ *
+ *  Created on: Mar 25, 2017
+ *      Author: nico
+ *
+ *  grammar of an LZ77-style parse, for extremely repetitive texts. The text is read as a stream and parsed
+ *  into literals and copies of earlier text (of length >= block):
+ *
+ *  - matcher: Karp-Rabin fingerprints of the text blocks text[k*block, (k+1)*block) that were parsed as
+ *    literals are stored in a hash table. At every literal position the fingerprint of the next block is
+ *    looked up; a candidate copy is verified and extended forward (and backward over the last literals)
+ *    by reading the earlier text from the grammar itself. Blocks inside copies are not indexed: their
+ *    content already occurs earlier.
+ *  - grammar: the parsed text is a stack of symbols whose lengths more than double towards the bottom
+ *    (adjacent symbols are merged with a new rule otherwise, equal rules are created once). A copy
+ *    appends the O(h) symbols covering its source, h = grammar height, so every copy is found in the
+ *    grammar built so far and the rules form a balanced straight-line program.
+ *  - optionally (repair_pass), the literals are compressed with Re-Pair once the text is parsed and the
+ *    parse is replayed on a new stack, appending Re-Pair's symbols instead of the literal characters (which
+ *    the fingerprints alone compress poorly: only whole blocks are found).
+ *
+ *  The text itself is never stored: memory is O(z log n) words for z phrases (rules, appended symbols) plus
+ *  O(number of literals / block) for the fingerprints, and a look-ahead buffer (with repair_pass, plus the
+ *  literals and Re-Pair's memory on them). Reading the input takes O(n) time, every other step is
+ *  proportional to the parse.
+ *
+ *  The output <A, G, T_vec> has the format of re_pair.hpp and can be stored with rp_archive.
+ *
+ */
+
+#ifndef INTERNAL_LZ_GRAMMAR_HPP_
+#define INTERNAL_LZ_GRAMMAR_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32c.hpp"
+#include "pair_key.hpp"
+#include "re_pair.hpp"
+#include "rule_order.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class lz_grammar{
+
+public:
+
+	/*
+	 * copies are at least block characters long
+	 */
+	lz_grammar(uint64_t block = 32){
+
+		assert(block > 0);
+
+		this->block = block;
+
+		pow_block = 1;
+		for(uint64_t k=1;k<block;++k) pow_block *= BASE;
+
+	}
+
+	/*
+	 * if true, the literals are compressed with Re-Pair (the parse and the literals are then kept until
+	 * the end)
+	 */
+	bool repair_pass = true;
+
+	/*
+	 * parse the text read from stream in and compute <A, G, T_vec>
+	 */
+	void compress(istream & in){
+
+		parse(in);
+
+		fingerprints = {};
+
+		build_output();
+
+	}
+
+	uint64_t number_of_copies(){
+		return copies;
+	}
+
+	uint64_t number_of_literals(){
+		return literals;
+	}
+
+	/*
+	 * number of symbols appended to the stack (literals and copy covers)
+	 */
+	uint64_t number_of_pieces(){
+		return n_pieces;
+	}
+
+	vector<itype> A; //alphabet (mapping int->ascii)
+	vector<pair<itype, itype> > G; //grammar
+	vector<itype> T_vec;// compressed text
+
+	uint32_t text_crc = 0; //CRC32C of the input text
+	uint64_t text_length = 0;
+
+private:
+
+	static const uint64_t BASE = 0x100000001b3ULL; //fingerprints are polynomials in BASE modulo 2^64
+
+	/*
+	 * symbols: character c is c, rule k (R[k]) is 256 + k
+	 */
+	uint64_t length(itype s){
+		return s < 256 ? 1 : L[s-256];
+	}
+
+	/*
+	 * the rule ab (created if it does not exist)
+	 */
+	itype rule(itype a, itype b){
+
+		auto it = rule_id.find(pack_pair(a,b));
+
+		if(it != rule_id.end()) return it->second;
+
+		itype X = 256 + R.size();
+
+		R.push_back({a,b});
+		L.push_back(length(a) + length(b));
+
+		rule_id[pack_pair(a,b)] = X;
+
+		return X;
+
+	}
+
+	/*
+	 * append symbol s to the parsed text
+	 */
+	void append(itype s){
+
+		n_pieces++;
+
+		parsed += length(s);
+		stack.push_back(s);
+
+		while(stack.size() > 1 and length(stack[stack.size()-2]) <= 2*length(stack.back())){
+
+			itype b = stack.back();
+			stack.pop_back();
+
+			stack.back() = rule(stack.back(),b);
+
+		}
+
+	}
+
+	/*
+	 * append to out the symbols covering expansion(X)[off, off+l)
+	 */
+	void cover(itype X, uint64_t off, uint64_t l, vector<itype> & out){
+
+		if(off == 0 and l == length(X)){
+
+			out.push_back(X);
+			return;
+
+		}
+
+		assert(X >= 256);
+
+		itype a = R[X-256].first;
+		itype b = R[X-256].second;
+
+		uint64_t la = length(a);
+
+		if(off < la) cover(a, off, std::min(l, la-off), out);
+		if(off+l > la) cover(b, off < la ? 0 : off-la, off < la ? off+l-la : l, out);
+
+	}
+
+	/*
+	 * reads the parsed text sequentially from position i
+	 */
+	struct reader{
+
+		reader(lz_grammar & Z, uint64_t i) : Z(Z){
+
+			uint64_t start = 0;
+			uint64_t k = 0;
+
+			while(start + Z.length(Z.stack[k]) <= i) start += Z.length(Z.stack[k++]);
+
+			for(uint64_t j=Z.stack.size();j>k+1;--j) S.push_back(Z.stack[j-1]);
+
+			//descend to position i
+			itype X = Z.stack[k];
+			uint64_t off = i - start;
+
+			while(X >= 256){
+
+				itype a = Z.R[X-256].first;
+				itype b = Z.R[X-256].second;
+
+				if(off < Z.length(a)){
+
+					S.push_back(b);
+					X = a;
+
+				}else{
+
+					off -= Z.length(a);
+					X = b;
+
+				}
+
+			}
+
+			S.push_back(X);
+
+		}
+
+		uint8_t next(){
+
+			while(S.back() >= 256){
+
+				itype X = S.back();
+				S.pop_back();
+
+				S.push_back(Z.R[X-256].second);
+				S.push_back(Z.R[X-256].first);
+
+			}
+
+			uint8_t c = S.back();
+			S.pop_back();
+
+			return c;
+
+		}
+
+		lz_grammar & Z;
+		vector<itype> S; //symbols still to expand, next on top
+
+	};
+
+	/*
+	 * character at position i < parsed
+	 */
+	uint8_t char_at(uint64_t i){
+
+		reader r(*this,i);
+		return r.next();
+
+	}
+
+	/*
+	 * parse stream in into literals and copies
+	 */
+	void parse(istream & in){
+
+		string buf; //text[buf_start, buf_start + buf.size())
+		uint64_t buf_start = 0;
+		bool eof = false;
+
+		//make text[i] available, if it exists
+		auto available = [&](uint64_t i){
+
+			while(not eof and i >= buf_start + buf.size()){
+
+				char chunk[1<<16];
+				in.read(chunk,sizeof(chunk));
+
+				uint64_t r = in.gcount();
+
+				if(r == 0){
+
+					eof = true;
+					break;
+
+				}
+
+				text_crc = crc32c::update(text_crc,(const uint8_t*)chunk,r);
+				text_length += r;
+
+				//drop the text that is already in the grammar
+				if(parsed - buf_start > buf.size()/2 and parsed - buf_start > (1<<20)){
+
+					buf.erase(0,parsed - buf_start);
+					buf_start = parsed;
+
+				}
+
+				buf.append(chunk,r);
+
+			}
+
+			return i < buf_start + buf.size();
+
+		};
+
+		auto at = [&](uint64_t i){ return uint8_t(buf[i-buf_start]); };
+
+		uint64_t i = 0; //text[0, i) is parsed or pending literal
+		uint64_t h = 0; //fingerprint of text[i, i+block)
+		bool h_valid = false;
+
+		string lit; //pending literals text[i-lit.size(), i)
+
+		//aligned blocks parsed as literals, not yet in the grammar: <position, fingerprint>
+		vector<pair<uint64_t,uint64_t> > unindexed;
+
+		auto commit = [&](uint64_t k){
+
+			for(uint64_t j=0;j<k;++j) append(uint8_t(lit[j]));
+
+			if(repair_pass and k > 0){
+
+				if(phrases.empty() or phrases.back().first != LITERALS) phrases.push_back({LITERALS,0});
+
+				phrases.back().second += k;
+				literal_text.append(lit,0,k);
+
+			}
+
+			literals += k;
+			lit.erase(0,k);
+
+			uint64_t j = 0;
+
+			for(;j<unindexed.size() and unindexed[j].first + block <= parsed;++j) fingerprints.insert({unindexed[j].second,unindexed[j].first});
+
+			unindexed.erase(unindexed.begin(),unindexed.begin()+j);
+
+		};
+
+		while(available(i)){
+
+			if(not available(i+block-1)){
+
+				//fewer than block characters left
+				lit.push_back(at(i++));
+				continue;
+
+			}
+
+			if(not h_valid){
+
+				h = 0;
+				for(uint64_t k=0;k<block;++k) h = h*BASE + at(i+k);
+
+				h_valid = true;
+
+			}
+
+			auto it = fingerprints.find(h);
+
+			if(it != fingerprints.end() and try_copy(it->second, i, lit, available, at, commit)){
+
+				h_valid = false;
+				continue;
+
+			}
+
+			if(i % block == 0) unindexed.push_back({i,h});
+
+			lit.push_back(at(i));
+
+			if(available(i+block)) h = (h - at(i)*pow_block)*BASE + at(i+block);
+			else h_valid = false;
+
+			i++;
+
+			//keep at most block pending literals (for the backward extension of copies)
+			if(lit.size() > 2*block) commit(lit.size()-block);
+
+		}
+
+		commit(lit.size());
+
+	}
+
+	/*
+	 * text[i, i+block) has the fingerprint of text[p, p+block) (p+block <= parsed). If the texts match, extend
+	 * the match, append the copy (and the literals before it) and advance i past it
+	 */
+	template<typename available_t, typename at_t, typename commit_t>
+	bool try_copy(uint64_t p, uint64_t & i, string & lit, available_t & available, at_t & at, commit_t & commit){
+
+		//forward. The source is in the grammar up to parsed, then in the buffer
+		uint64_t l = 0;
+
+		{
+			reader r(*this,p);
+
+			while(available(i+l)){
+
+				uint8_t c = p+l < parsed ? r.next() : at(p+l);
+
+				if(c != at(i+l)) break;
+
+				l++;
+
+			}
+		}
+
+		if(l < block) return false;
+
+		//backward, over the pending literals
+		while(not lit.empty() and p > 0 and char_at(p-1) == uint8_t(lit.back())){
+
+			lit.pop_back();
+			p--;
+			i--;
+			l++;
+
+		}
+
+		commit(lit.size());
+
+		assert(parsed == i);
+
+		append_copy(p,l);
+
+		if(repair_pass) phrases.push_back({p,l});
+
+		copies++;
+		i += l;
+
+		return true;
+
+	}
+
+	/*
+	 * append the symbols covering text[p, p+l) (p < parsed)
+	 */
+	void append_copy(uint64_t p, uint64_t l){
+
+		//the copy may overlap its source: copy the available part, then the copy itself
+		uint64_t done = 0;
+
+		while(done < l){
+
+			uint64_t src = p + done;
+			uint64_t len = std::min(l - done, parsed - src);
+
+			vector<itype> C;
+			uint64_t start = 0;
+
+			for(auto X : stack){
+
+				uint64_t lx = length(X);
+
+				if(start + lx > src and start < src + len){
+
+					uint64_t b = std::max(start,src);
+					uint64_t e = std::min(start+lx,src+len);
+
+					cover(X, b-start, e-b, C);
+
+				}
+
+				start += lx;
+
+			}
+
+			for(auto X : C) append(X);
+
+			done += len;
+
+		}
+
+	}
+
+	/*
+	 * Re-Pair on the literals (runs separated by a symbol that is never paired), then the parse is replayed on
+	 * an empty grammar: the literal runs are appended as Re-Pair's symbols, the copies as before
+	 */
+	void repair_literals(){
+
+		const itype SEP = 256;
+
+		vector<itype> S;
+		uint64_t k = 0; //next character of literal_text
+
+		for(auto ph : phrases){
+
+			if(ph.first != LITERALS) continue;
+
+			if(not S.empty()) S.push_back(SEP);
+
+			for(uint64_t j=0;j<ph.second;++j) S.push_back(uint8_t(literal_text[k++]));
+
+		}
+
+		string().swap(literal_text);
+
+		//the grammar of the parse is no longer needed
+		vector<pair<itype,itype> >().swap(R);
+		vector<uint64_t>().swap(L);
+		rule_id = {};
+		vector<itype>().swap(stack);
+		parsed = 0;
+		n_pieces = 0;
+
+		re_pair<itype> RP(false);
+
+		RP.separator = SEP;
+		RP.compress_symbols(S);
+
+		itype sigma = RP.A.size();
+
+		//Re-Pair's symbols as symbols of this grammar
+		vector<itype> id(sigma + RP.G.size());
+
+		for(itype x=0;x<sigma;++x) id[x] = RP.A[x];
+		for(uint64_t j=0;j<RP.G.size();++j) id[sigma+j] = rule(id[RP.G[j].first],id[RP.G[j].second]);
+
+		vector<pair<itype,itype> >().swap(RP.G);
+
+		auto separator = [&](itype x){ return x < sigma and RP.A[x] == SEP; };
+
+		uint64_t t = 0; //next symbol of RP.T_vec
+
+		for(auto ph : phrases){
+
+			if(ph.first != LITERALS){
+
+				append_copy(ph.first,ph.second);
+				continue;
+
+			}
+
+			for(;t < RP.T_vec.size() and not separator(RP.T_vec[t]);++t) append(id[RP.T_vec[t]]);
+
+			t++; //the separator
+
+		}
+
+		vector<pair<uint64_t,uint64_t> >().swap(phrases);
+
+	}
+
+	/*
+	 * <A, G, T_vec> from the stack
+	 */
+	void build_output(){
+
+		if(repair_pass and not literal_text.empty()) repair_literals();
+
+		//the rules reachable from T, in creation order (children first)
+		auto reachable = [&](const vector<itype> & T){
+
+			vector<bool> used(R.size(),false);
+
+			for(auto s : T) if(s >= 256) used[s-256] = true;
+
+			for(uint64_t k=R.size();k>0;--k){
+
+				if(not used[k-1]) continue;
+
+				if(R[k-1].first >= 256) used[R[k-1].first-256] = true;
+				if(R[k-1].second >= 256) used[R[k-1].second-256] = true;
+
+			}
+
+			return used;
+
+		};
+
+		vector<bool> used = reachable(stack);
+
+		//the rules used once (mostly the merges of the stack that no copy refers to) are expanded in T
+		vector<uint32_t> refs(R.size(),0);
+
+		for(auto s : stack) if(s >= 256) refs[s-256]++;
+
+		for(uint64_t k=0;k<R.size();++k){
+
+			if(not used[k]) continue;
+
+			if(R[k].first >= 256) refs[R[k].first-256]++;
+			if(R[k].second >= 256) refs[R[k].second-256]++;
+
+		}
+
+		vector<itype> T;
+
+		for(auto s : stack){
+
+			vector<itype> S = {s};
+
+			while(not S.empty()){
+
+				itype X = S.back();
+				S.pop_back();
+
+				if(X >= 256 and refs[X-256] == 1){
+
+					S.push_back(R[X-256].second);
+					S.push_back(R[X-256].first);
+
+				}else{
+
+					T.push_back(X);
+
+				}
+
+			}
+
+		}
+
+		vector<itype>().swap(stack);
+		refs = {};
+
+		used = reachable(T);
+
+		vector<bool> present(256,false);
+
+		for(auto s : T) if(s < 256) present[s] = true;
+
+		for(uint64_t k=0;k<R.size();++k){
+
+			if(not used[k]) continue;
+
+			if(R[k].first < 256) present[R[k].first] = true;
+			if(R[k].second < 256) present[R[k].second] = true;
+
+		}
+
+		vector<itype> terminal(256,0);
+
+		for(uint64_t c=0;c<256;++c){
+
+			if(present[c]){
+
+				terminal[c] = A.size();
+				A.push_back(c);
+
+			}
+
+		}
+
+		itype sigma = A.size();
+
+		vector<itype> new_id(R.size(),0);
+		itype g = 0;
+
+		for(uint64_t k=0;k<R.size();++k) if(used[k]) new_id[k] = sigma + g++;
+
+		auto final_symbol = [&](itype s){ return s < 256 ? terminal[s] : new_id[s-256]; };
+
+		for(uint64_t k=0;k<R.size();++k) if(used[k]) G.push_back({final_symbol(R[k].first),final_symbol(R[k].second)});
+		for(auto s : T) T_vec.push_back(final_symbol(s));
+
+		sort_rules(G, T_vec, sigma);
+
+	}
+
+	uint64_t block = 32;
+	uint64_t pow_block = 1; //BASE^(block-1)
+
+	vector<pair<itype,itype> > R; //rules
+	vector<uint64_t> L; //expansion lengths of the rules
+	unordered_map<pair_key_t,itype,pair_key_hash> rule_id;
+
+	vector<itype> stack; //the parsed text
+	uint64_t parsed = 0; //its length
+
+	uint64_t n_pieces = 0; //symbols appended to the stack
+
+	//if repair_pass: the parse (<LITERALS, length> or <source, length>) and the literals
+	static const uint64_t LITERALS = ~uint64_t(0);
+	vector<pair<uint64_t,uint64_t> > phrases;
+	string literal_text;
+
+	unordered_map<uint64_t,uint64_t> fingerprints; //fingerprint of an indexed block -> its position
+
+	uint64_t copies = 0;
+	uint64_t literals = 0;
+
+};
+
+template<typename itype> const uint64_t lz_grammar<itype>::BASE;
+template<typename itype> const uint64_t lz_grammar<itype>::LITERALS;
+
+#endif /* INTERNAL_LZ_GRAMMAR_HPP_ */
@@ -0,0 +1,479 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * message_context.hpp
+ *
+ *  Created on: Mar 20, 2017
+ *      Author: nico
+ *
+ *  stateful compression of a stream of small messages with a grammar shared by all messages of the stream.
+ *
+ *  The sender's context compresses a message in three steps:
+ *
+ *  1. the message's characters are parsed with the rules built so far (repeatedly replacing the adjacent
+ *     pair whose rule is the oldest, so that children are applied before their parents);
+ *  2. Re-Pair-style new rules are created, most frequent pair first, for the pairs occurring at least
+ *     twice in the message or seen in the parses of previous messages;
+ *  3. the pairs of the final parse are recorded for the next messages.
+ *
+ *  The encoded message contains only the new rules (the delta) and the parse; the receiver's context
+ *  applies the delta to its copy of the rules and expands the parse. Messages must be decompressed in
+ *  the order they were compressed.
+ *
+ *  Memory is bounded: rules use at most max_rules slots (symbols 256, ..., 256+max_rules-1) and at most
+ *  max_pairs pairs of past messages are remembered (the table is cleared when full). When all slots are
+ *  used, the least recently used rule that is not a child of another rule (and not used by the current
+ *  message) is evicted and its slot is reused; the delta names the slots, so the receiver does not need
+ *  to replicate the eviction policy.
+ *
+ *  Encoded message (LEB128 varints): <d, (slot, a, b) * d, t, symbol * t>. The receiver checks every
+ *  field, so a corrupted or forged message is rejected instead of corrupting the context.
+ *
+ *  Complexity: O(m^2) per message of length m in the worst case (messages are expected to be small),
+ *  O(max_rules + max_pairs) words of memory.
+ *
+ */
+
+#ifndef INTERNAL_MESSAGE_CONTEXT_HPP_
+#define INTERNAL_MESSAGE_CONTEXT_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class message_context{
+
+public:
+
+	using ipair = pair<itype,itype>;
+
+	/*
+	 * a context stores at most max_rules rules and remembers at most max_pairs pairs of past messages.
+	 * The sender's and the receiver's contexts must use the same max_rules
+	 */
+	message_context(uint64_t max_rules = 1<<16, uint64_t max_pairs = 1<<16){
+
+		this->max_rules = max_rules;
+		this->max_pairs = max_pairs;
+
+		rules = vector<ipair>(max_rules,{null,null});
+		stamp = vector<uint64_t>(max_rules,0);
+		last_used = vector<uint64_t>(max_rules,0);
+		refs = vector<itype>(max_rules,0);
+
+		for(itype s=0;s<max_rules;++s) free_slots.push_back(max_rules-1-s);
+
+	}
+
+	/*
+	 * compress message msg. Return the encoded message
+	 */
+	string compress_message(const string & msg){
+
+		messages++;
+
+		vector<itype> S;
+		for(auto c : msg) S.push_back(uint8_t(c));
+
+		vector<itype> delta;
+
+		parse(S);
+		new_rules(S, delta);
+
+		//remember the pairs of the final parse
+		if(seen.size() + S.size() > max_pairs) seen = {};
+
+		for(uint64_t i=1;i<S.size();++i) seen[key({S[i-1],S[i]})]++;
+
+		string code;
+
+		put(code, delta.size()/3);
+		for(auto x : delta) put(code, x);
+
+		put(code, S.size());
+		for(auto x : S) put(code, x);
+
+		return code;
+
+	}
+
+	/*
+	 * decompress message code (produced by the mirrored sender's context) into msg. Return false, leaving
+	 * the context unchanged, if code is malformed (truncated, naming a slot out of range or an undefined
+	 * rule, trailing bytes) or if the message would be longer than max_length characters
+	 */
+	bool decompress_message(const string & code, string & msg, uint64_t max_length = 1<<26){
+
+		msg.clear();
+
+		uint64_t i = 0;
+		uint64_t d;
+
+		if(not get(code, i, d)) return false;
+
+		//previous content of the slots overwritten by the delta, restored if code is malformed
+		vector<pair<itype,pair<ipair,uint64_t> > > old;
+
+		auto fail = [&](){
+
+			for(uint64_t k=old.size();k>0;--k){
+
+				rules[old[k-1].first] = old[k-1].second.first;
+				stamp[old[k-1].first] = old[k-1].second.second;
+
+			}
+
+			rules_created -= old.size();
+			msg.clear();
+
+			return false;
+
+		};
+
+		for(uint64_t k=0;k<d;++k){
+
+			uint64_t s, a, b;
+
+			if(not get(code, i, s) or not get(code, i, a) or not get(code, i, b)) return fail();
+
+			if(s < 256 or not is_symbol(s) or not defined(a) or not defined(b)) return fail();
+
+			old.push_back({itype(s-256),{rules[s-256],stamp[s-256]}});
+
+			//children are older than their parent: expansions are finite
+			rules[s-256] = {itype(a),itype(b)};
+			stamp[s-256] = ++rules_created;
+
+		}
+
+		uint64_t t;
+
+		if(not get(code, i, t)) return fail();
+
+		vector<itype> stack;
+
+		for(uint64_t k=0;k<t;++k){
+
+			uint64_t x;
+
+			if(not get(code, i, x) or not defined(x)) return fail();
+
+			stack.push_back(itype(x));
+
+			while(not stack.empty()){
+
+				itype X = stack.back();
+				stack.pop_back();
+
+				if(X < 256){
+
+					if(msg.size() == max_length) return fail();
+
+					msg.push_back(char(X));
+
+				}else{
+
+					ipair ab = rules[X-256];
+
+					for(auto c : {ab.first,ab.second}) if(c >= 256 and stamp[c-256] >= stamp[X-256]) return fail();
+
+					stack.push_back(ab.second);
+					stack.push_back(ab.first);
+
+				}
+
+			}
+
+		}
+
+		if(i != code.size()) return fail();
+
+		return true;
+
+	}
+
+	/*
+	 * number of rules currently stored
+	 */
+	uint64_t number_of_rules(){
+		return pair_to_rule.size();
+	}
+
+	/*
+	 * number of rules evicted so far
+	 */
+	uint64_t number_of_evictions(){
+		return evictions;
+	}
+
+private:
+
+	static const itype null = ~itype(0);
+
+	static uint64_t key(ipair ab){
+		return (uint64_t(ab.first) << 32) | uint32_t(ab.second);
+	}
+
+	/*
+	 * step 1: replace in S the pairs that already have a rule, oldest rule first
+	 */
+	void parse(vector<itype> & S){
+
+		while(true){
+
+			itype best = null;
+
+			for(uint64_t i=1;i<S.size();++i){
+
+				auto it = pair_to_rule.find(key({S[i-1],S[i]}));
+
+				if(it != pair_to_rule.end() and (best == null or stamp[it->second-256] < stamp[best-256])) best = it->second;
+
+			}
+
+			if(best == null) return;
+
+			replace(S, rules[best-256], best);
+
+		}
+
+	}
+
+	/*
+	 * step 2: create rules for the pairs of S occurring at least twice, counting the occurrences
+	 * in the previous messages' parses. The new rules are appended to delta as (slot, a, b)
+	 */
+	void new_rules(vector<itype> & S, vector<itype> & delta){
+
+		while(S.size() > 1){
+
+			unordered_map<uint64_t,uint64_t> freq;
+
+			for(uint64_t i=1;i<S.size();++i) freq[key({S[i-1],S[i]})]++;
+
+			uint64_t best_key = 0;
+			uint64_t best_f = 0;
+
+			for(auto & f : freq){
+
+				auto it = seen.find(f.first);
+				uint64_t F = f.second + (it == seen.end() ? 0 : it->second);
+
+				if(F > best_f or (F == best_f and f.first < best_key)){
+
+					best_key = f.first;
+					best_f = F;
+
+				}
+
+			}
+
+			if(best_f < 2) return;
+
+			itype X = new_slot();
+
+			if(X == null) return;
+
+			ipair ab = {itype(best_key >> 32), itype(uint32_t(best_key))};
+
+			rules[X-256] = ab;
+			stamp[X-256] = ++rules_created;
+			pair_to_rule[best_key] = X;
+			seen.erase(best_key);
+
+			for(auto c : {ab.first,ab.second}){
+
+				if(c < 256) continue;
+
+				if(refs[c-256]++ == 0) evictable.erase({last_used[c-256],c});
+
+			}
+
+			evictable.insert({messages,X});
+			last_used[X-256] = messages;
+
+			delta.push_back(X);
+			delta.push_back(ab.first);
+			delta.push_back(ab.second);
+
+			replace(S, ab, X);
+
+		}
+
+	}
+
+	/*
+	 * replace the non-overlapping occurrences of ab in S (left to right) with rule X, and mark X as used
+	 */
+	void replace(vector<itype> & S, ipair ab, itype X){
+
+		uint64_t j = 0;
+
+		for(uint64_t i=0;i<S.size();++i){
+
+			if(i+1 < S.size() and S[i] == ab.first and S[i+1] == ab.second){
+
+				S[j++] = X;
+				i++;
+
+			}else{
+
+				S[j++] = S[i];
+
+			}
+
+		}
+
+		S.resize(j);
+
+		if(refs[X-256] == 0){
+
+			evictable.erase({last_used[X-256],X});
+			evictable.insert({messages,X});
+
+		}
+
+		last_used[X-256] = messages;
+
+	}
+
+	/*
+	 * a free slot, evicting the least recently used rule if needed. Return null if every
+	 * rule is a child of another rule or is used by the current message
+	 */
+	itype new_slot(){
+
+		if(free_slots.empty()){
+
+			if(evictable.empty() or evictable.begin()->first == messages) return null;
+
+			itype X = evictable.begin()->second;
+			evictable.erase(evictable.begin());
+
+			ipair ab = rules[X-256];
+
+			pair_to_rule.erase(key(ab));
+
+			for(auto c : {ab.first,ab.second}){
+
+				if(c < 256) continue;
+
+				if(--refs[c-256] == 0) evictable.insert({last_used[c-256],c});
+
+			}
+
+			rules[X-256] = {null,null};
+			free_slots.push_back(X-256);
+
+			evictions++;
+
+		}
+
+		itype s = free_slots.back();
+		free_slots.pop_back();
+
+		return 256+s;
+
+	}
+
+	static void put(string & code, uint64_t x){
+
+		while(x >= 128){
+
+			code.push_back(char(128 | (x & 127)));
+			x >>= 7;
+
+		}
+
+		code.push_back(char(x));
+
+	}
+
+	/*
+	 * read the varint starting at code[i] into x and move i past it. Return false if code ends before
+	 * its last byte or if it does not fit in 64 bits
+	 */
+	static bool get(const string & code, uint64_t & i, uint64_t & x){
+
+		x = 0;
+
+		for(uint64_t shift = 0;i < code.size() and shift < 64;shift += 7){
+
+			uint8_t c = code[i++];
+
+			if(shift == 63 and c > 1) return false;
+
+			x |= uint64_t(c & 127) << shift;
+
+			if(c < 128) return true;
+
+		}
+
+		return false;
+
+	}
+
+	/*
+	 * true iff x is a character or the symbol of a slot
+	 */
+	bool is_symbol(uint64_t x){
+		return x < 256 + max_rules;
+	}
+
+	/*
+	 * true iff x is a character or a rule stored in its slot
+	 */
+	bool defined(uint64_t x){
+		return is_symbol(x) and (x < 256 or rules[x-256].first != null);
+	}
+
+	uint64_t max_rules = 0;
+	uint64_t max_pairs = 0;
+
+	uint64_t messages = 0; //messages compressed so far (the current one included)
+	uint64_t rules_created = 0;
+	uint64_t evictions = 0;
+
+	//rules[s] = children of symbol 256+s
+	vector<ipair> rules;
+
+	//creation time of the rule in each slot
+	vector<uint64_t> stamp;
+
+	//sender only: last message using it and number of rules using it, per slot
+	vector<uint64_t> last_used;
+	vector<itype> refs;
+
+	unordered_map<uint64_t,itype> pair_to_rule;
+
+	//<last use, symbol> of the rules that are not children of other rules
+	set<pair<uint64_t,itype> > evictable;
+
+	vector<itype> free_slots;
+
+	//pairs of the parses of the previous messages, with their frequencies
+	unordered_map<uint64_t,uint64_t> seen;
+
+};
+
+template<typename itype> const itype message_context<itype>::null;
+
+#endif /* INTERNAL_MESSAGE_CONTEXT_HPP_ */
@@ -0,0 +1,124 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * packed_array.hpp
+ *
+ *  Created on: Mar 23, 2017
+ *      Author: nico
+ *
+ *  fixed-size array of n integers of w bits each (1 <= w <= 64), packed in 64-bit words.
+ *  Access and update in O(1) time.
+ *
+ */
+
+#ifndef INTERNAL_PACKED_ARRAY_HPP_
+#define INTERNAL_PACKED_ARRAY_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class packed_array{
+
+public:
+
+	packed_array(){}
+
+	/*
+	 * n integers of width w, initialized to 0
+	 */
+	packed_array(uint64_t n, uint64_t w){
+
+		assert(w > 0 and w <= 64);
+
+		this->n = n;
+		this->w = w;
+
+		mask = w == 64 ? ~uint64_t(0) : (uint64_t(1) << w) - 1;
+
+		//one extra word, so that reading across a word boundary never goes out of bounds
+		words = vector<uint64_t>((n*w)/64 + 2, 0);
+
+	}
+
+	/*
+	 * number of bits needed to store x (at least 1)
+	 */
+	static uint64_t width(uint64_t x){
+
+		return x == 0 ? 1 : 64 - __builtin_clzll(x);
+
+	}
+
+	uint64_t operator[](uint64_t i) const{
+
+		assert(i < n);
+
+		uint64_t b = i*w;
+		uint64_t off = b % 64;
+
+		uint64_t x = words[b/64] >> off;
+
+		if(off + w > 64) x |= words[b/64+1] << (64-off);
+
+		return x & mask;
+
+	}
+
+	void set(uint64_t i, uint64_t x){
+
+		assert(i < n);
+		assert((x & mask) == x);
+
+		uint64_t b = i*w;
+		uint64_t off = b % 64;
+
+		words[b/64] = (words[b/64] & ~(mask << off)) | (x << off);
+
+		if(off + w > 64){
+
+			uint64_t hi = w - (64-off); //bits in the next word
+
+			words[b/64+1] = (words[b/64+1] & ~(mask >> (w-hi))) | (x >> (64-off));
+
+		}
+
+	}
+
+	uint64_t size() const{
+		return n;
+	}
+
+	uint64_t bit_width() const{
+		return w;
+	}
+
+	uint64_t bytes() const{
+		return words.size()*sizeof(uint64_t);
+	}
+
+private:
+
+	uint64_t n = 0;
+	uint64_t w = 1;
+	uint64_t mask = 1;
+
+	vector<uint64_t> words;
+
+};
+
+#endif /* INTERNAL_PACKED_ARRAY_HPP_ */
@@ -0,0 +1,121 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * packed_dna.hpp
+ *
+ *  Created on: Mar 12, 2017
+ *      Author: nico
+ *
+ *  sequence of nucleotides (codes 0,1,2,3 = A,C,G,T) packed at 2 bits per base, 32 bases per word.
+ *
+ *  pair_histogram() counts the 16 possible pairs of adjacent bases working on whole words: for
+ *  every base a, the fields equal to a are found with a xor and a fold, and the pairs (a,b) are
+ *  counted with a popcount of the matches of a and of b in the word shifted by one base.
+ *
+ */
+
+#ifndef INTERNAL_PACKED_DNA_HPP_
+#define INTERNAL_PACKED_DNA_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class packed_dna{
+
+public:
+
+	packed_dna(){}
+
+	void push_back(uint8_t c){
+
+		assert(c < 4);
+
+		if(n%32 == 0) W.push_back(0);
+
+		W.back() |= uint64_t(c) << (2*(n%32));
+		n++;
+
+	}
+
+	/*
+	 * code of the i-th base
+	 */
+	itype operator[](uint64_t i) const{
+
+		assert(i<n);
+
+		return (W[i/32] >> (2*(i%32))) & uint64_t(3);
+
+	}
+
+	uint64_t size() const{
+		return n;
+	}
+
+	/*
+	 * H[4*a+b] = number of positions i < n-1 such that base i is a and base i+1 is b
+	 */
+	vector<uint64_t> pair_histogram() const{
+
+		const uint64_t LOW = 0x5555555555555555ULL; //low bit of every field
+
+		vector<uint64_t> H(16,0);
+
+		for(uint64_t w=0;w<W.size();++w){
+
+			uint64_t x = W[w]; //bases i
+			uint64_t y = (W[w] >> 2) | (w+1 < W.size() ? W[w+1] << 62 : 0); //bases i+1
+
+			//m = number of pairs starting at positions 32w, ..., 32w+31 (i.e. at positions < n-1)
+			uint64_t m = n-1 > 32*w ? std::min(uint64_t(32), n-1-32*w) : 0;
+			uint64_t valid = m == 0 ? 0 : LOW >> (2*(32-m));
+
+			uint64_t ex[4];
+			uint64_t ey[4];
+
+			for(uint64_t a=0;a<4;++a){
+
+				uint64_t tx = x ^ (a*LOW);
+				uint64_t ty = y ^ (a*LOW);
+
+				//low bit of a field is 1 iff the field equals a
+				ex[a] = ~(tx | (tx >> 1)) & valid;
+				ey[a] = ~(ty | (ty >> 1)) & LOW;
+
+			}
+
+			for(uint64_t a=0;a<4;++a)
+				for(uint64_t b=0;b<4;++b)
+					H[4*a+b] += __builtin_popcountll(ex[a] & ey[b]);
+
+		}
+
+		return H;
+
+	}
+
+private:
+
+	vector<uint64_t> W;
+	uint64_t n = 0;
+
+};
+
+#endif /* INTERNAL_PACKED_DNA_HPP_ */
@@ -6,6 +6,22 @@
  *
  *  read/write integers in packed form in/from a file
  *
+ *  The integers are cut into blocks of B = block_size integers, stored with the bit-width of the
+ *  largest integer in their block; the widths are delta- and run-length encoded. File layout:
+ *
+ *  	gamma(n), <run-length encoded widths>, n packed integers
+ *
+ *  If per_stream is set, the integers are split by the writer into streams (see end_stream()), e.g.
+ *  the sections of an archive, and B is chosen per stream among block_sizes by computing the exact
+ *  size of the stream for every candidate. File layout:
+ *
+ *  	gamma(1), gamma(number of streams), then for each stream:
+ *  	gamma(B), gamma(n), <run-length encoded widths>, n packed integers
+ *
+ *  The multi-stream layout is written only if it is smaller than the single stream. It is recognized
+ *  by the leading gamma(1) (a single-stream file never stores exactly one integer), so both layouts
+ *  are read. Decoders without per-stream block sizes cannot read multi-stream files.
+ *
  */
 
 #ifndef INTERNAL_PACKED_GAMMA_FILE3_HPP_
@@ -17,8 +33,6 @@
 
 using namespace std;
 
-#endif /* INTERNAL_PACKED_GAMMA_FILE3_HPP_ */
-
 template<typename itype = uint32_t, uint64_t block_size = 6>
 class packed_gamma_file3{
 
@@ -53,6 +67,11 @@ public:
 
 	}
 
+	/*
+	 * if true, the writer may choose a block size per stream (multi-stream layout)
+	 */
+	bool per_stream = false;
+
 	/*
 	 * append integer x in packed form to the file
 	 */
@@ -62,22 +81,30 @@ public:
 
 		buffer.push_back(x);
 
-		if(buffer.size()%block_size == 0){
+		lower_bound_bitsize += wd(x);
 
-			uint8_t max_bitsize = 0;
+	}
 
-			for(uint64_t i=buffer.size()-block_size;i<buffer.size();++i){
+	/*
+	 * the integers pushed since the previous call form a stream with its own block size.
+	 * Empty streams are ignored
+	 */
+	void end_stream(){
 
-				max_bitsize = std::max(max_bitsize,wd(buffer[i]));
+		assert(write);
 
-			}
+		uint64_t b = stream_ends.empty() ? 0 : stream_ends.back();
 
-			blocks_bitsizes.push_back(max_bitsize);
+		if(buffer.size() > b) stream_ends.push_back(buffer.size());
 
-		}
+	}
 
-		lower_bound_bitsize += wd(x);
+	/*
+	 * block size chosen for each stream (filled by close())
+	 */
+	vector<uint64_t> stream_block_sizes(){
 
+		return chosen_block_sizes;
 
 	}
 
@@ -114,20 +141,7 @@ public:
 
 		assert(write);
 
-		//in this case we did not compute last bitsize
-		if(buffer.size()%block_size != 0){
-
-			uint8_t max_bitsize = 0;
-
-			for(uint64_t i=(buffer.size()/block_size)*block_size;i<buffer.size();++i){
-
-				max_bitsize = std::max(max_bitsize,wd(buffer[i]));
-
-			}
-
-			blocks_bitsizes.push_back(max_bitsize);
-
-		}
+		end_stream();
 
 		flush_to_file();
 
@@ -172,12 +186,15 @@ public:
 	 *
 	 * 	- TOTAL SIZE: A log A + G log G + G + 2M log (G/M) + G log M bits
 	 *
+	 * 	optional archive sections (already serialized) are appended after T. If verbose, print statistics
+	 *
 	 */
-	void compress_and_store(vector<itype> & A, vector<pair<itype,itype> > & G, vector<itype> & T){
+	void compress_and_store(vector<itype> & A, vector<pair<itype,itype> > & G, vector<itype> & T, const vector<itype> & sections = {}, bool verbose = true){
 
 		//store A
 		push_back(A.size());
 		for(auto a : A) push_back(a);
+		end_stream();
 
 		//store G
 		vector<itype> deltas; //deltas between the pair's maximums
@@ -218,21 +235,28 @@ public:
 
 		}
 
-		push_back(deltas.size()); for(auto x:deltas) push_back(x);
-		push_back(starting_values.size());for(auto x:starting_values) push_back(x);
-		push_back(deltas_starting_points.size());for(auto x:deltas_starting_points) push_back(x);
+		//each component is a stream with its own block size
+		push_back(deltas.size()); for(auto x:deltas) push_back(x); end_stream();
+		push_back(starting_values.size());for(auto x:starting_values) push_back(x); end_stream();
+		push_back(deltas_starting_points.size());for(auto x:deltas_starting_points) push_back(x); end_stream();
 
-		push_back(deltas_minimums.size());for(auto x:deltas_minimums) push_back(x);
-		push_back(max_first.size());for(auto x:max_first) push_back(x);
+		push_back(deltas_minimums.size());for(auto x:deltas_minimums) push_back(x); end_stream();
+		push_back(max_first.size());for(auto x:max_first) push_back(x); end_stream();
 
 		//store T
 		push_back(T.size());
 		for(auto a : T) push_back(a);
+		end_stream();
+
+		//store optional sections
+		for(auto x : sections) push_back(x);
 
 		close();
 
 		auto wr = written_bytes()*8;
 
+		if(not verbose) return;
+
 		/*
 		 * statistics
 		 */
@@ -249,8 +273,18 @@ public:
 
 		double inf_min = g*min_bits_rule + t*log_gs + s*log_s;
 
+		//grammar height: terminals have height 0
+		vector<uint64_t> height(g);
+		uint64_t h = 0;
+
+		auto height_of = [&](uint64_t x){ return x < s ? 0 : height[x-s]; };
+
+		for(uint64_t r=0;r<g;++r) height[r] = 1 + std::max(height_of(G[r].first),height_of(G[r].second));
+		for(auto x : T) h = std::max(h,height_of(x));
+
 		cout << "Compressed file size : " << wr/8 << " Bytes" << endl;
 		cout << "Grammar size : g = " << g << " rules" << endl;
+		cout << "Grammar height : h = " << h << endl;
 		cout << "Number of characters in the final text : t = " << t << endl;
 		cout << "log_2 g = " << log_g << endl;
 		cout << starting_values.size() << " increasing sequences" << endl << endl;
@@ -261,6 +295,9 @@ public:
 		cout << "information-theoretic minimum number of bits to store the compressed file (grammar+text+alphabet) = " << inf_min << endl;
 		cout << "compression rate of grammar+text+alphabet (100*actual bitsize/information-theoretic minimum) = " << 100*double(wr)/double(inf_min) << " %" << endl;
 		cout << "Overhead w.r.t. bitsize of stored integers (prefix encoding): " << overhead() << "%" << endl;
+		cout << "Block size of each stream (alphabet, deltas, starting values, starting points, minimums, max first, text, sections; a single stream if smaller): ";
+		for(auto b : stream_block_sizes()) cout << b << " ";
+		cout << endl;
 
 	}
 
@@ -273,6 +310,17 @@ public:
 	 */
 	void read_and_decompress(vector<itype> & A, vector<pair<itype,itype> > & G, vector<itype> & T){
 
+		vector<itype> sections;
+		read_and_decompress(A,G,T,sections);
+
+	}
+
+	/*
+	 * as above, but also return the integers stored after T (optional archive sections).
+	 * Archives without sections return an empty vector.
+	 */
+	void read_and_decompress(vector<itype> & A, vector<pair<itype,itype> > & G, vector<itype> & T, vector<itype> & sections){
+
 		//empty arrays
 		A = {};
 		G = {};
@@ -304,6 +352,9 @@ public:
 		size = read(); for(uint64_t i=0;i<size;++i) max_first.push_back(read());
 		size = read(); for(uint64_t i=0;i<size;++i) T.push_back(read());
 
+		sections = {};
+		while(not eof()) sections.push_back(read());
+
 		//now retrieve G from the above vectors
 
 		uint64_t idx_in_deltas=0;
@@ -348,13 +399,140 @@ private:
 
 	void flush_to_file(){
 
-		//first, write number of integers in the file
-		flush_gamma_integer(buffer.size());
+		//single stream (readable by every version) unless per-stream block sizes are enabled and smaller
+		if(buffer.size() != 1 and (not per_stream or stream_cost(0,buffer.size(),block_size) <= choose_block_sizes())){
+
+			chosen_block_sizes = {block_size};
+
+			flush_stream(0,buffer.size(),block_size);
+			flush_bits();
+
+			return;
+
+		}
+
+		if(chosen_block_sizes.empty()) choose_block_sizes();
+
+		//marker of the multi-stream layout (a single-stream file never stores exactly 1 integer)
+		flush_gamma_integer(1);
+
+		flush_gamma_integer(stream_ends.size());
+
+		uint64_t b = 0;
+
+		for(uint64_t s=0;s<stream_ends.size();++s){
+
+			flush_gamma_integer(chosen_block_sizes[s]);
+			flush_stream(b,stream_ends[s],chosen_block_sizes[s]);
+
+			b = stream_ends[s];
+
+		}
+
+		flush_bits();
+
+	}
+
+	/*
+	 * choose the block size minimizing the size of each stream. Returns the size in bits of the
+	 * multi-stream layout
+	 */
+	uint64_t choose_block_sizes(){
+
+		chosen_block_sizes = {};
+
+		uint64_t multi_cost = gamma_length(1) + gamma_length(stream_ends.size());
+
+		uint64_t b = 0;
+
+		for(auto e : stream_ends){
+
+			uint64_t best = block_sizes[0];
+			uint64_t best_cost = stream_cost(b,e,best);
+
+			for(auto bs : block_sizes){
+
+				auto c = stream_cost(b,e,bs);
+
+				if(c < best_cost){
+
+					best = bs;
+					best_cost = c;
+
+				}
+
+			}
 
-		auto bitsizes = blocks_bitsizes;//store copy
+			chosen_block_sizes.push_back(best);
+			multi_cost += gamma_length(best) + best_cost;
 
-		assert(blocks_bitsizes.size()==(buffer.size()/block_size) + (buffer.size()%block_size != 0));
- 		//delta-encode bitsizes
+			b = e;
+
+		}
+
+		return multi_cost;
+
+	}
+
+	/*
+	 * bit-width of the largest integer in each block of size bs of buffer[b,e)
+	 */
+	vector<itype> bitsizes(uint64_t b, uint64_t e, uint64_t bs){
+
+		vector<itype> W;
+
+		for(uint64_t i=b;i<e;i+=bs){
+
+			uint8_t max_bitsize = 0;
+
+			for(uint64_t j=i;j<std::min(i+bs,e);++j) max_bitsize = std::max(max_bitsize,wd(buffer[j]));
+
+			W.push_back(max_bitsize);
+
+		}
+
+		return W;
+
+	}
+
+	/*
+	 * exact number of bits used by flush_stream(b,e,bs)
+	 */
+	uint64_t stream_cost(uint64_t b, uint64_t e, uint64_t bs){
+
+		auto W = bitsizes(b,e,bs);
+
+		uint64_t bits = gamma_length(e-b);
+
+		for(uint64_t k=0;k<W.size();++k) bits += W[k]*(std::min(b+(k+1)*bs,e) - (b+k*bs));
+
+		delta_encode(W);
+		auto R = run_length_encode(W);
+		auto R2 = run_length_encode(R.first);
+
+		bits += gamma_length(R.second.size()) + gamma_length(R2.second.size());
+
+		for(auto x:R.second) bits += gamma_length(x);
+		for(auto x:R2.first) bits += gamma_length(x);
+		for(auto x:R2.second) bits += gamma_length(x);
+
+		return bits;
+
+	}
+
+	/*
+	 * flush buffer[b,e) as a stream with blocks of size bs
+	 */
+	void flush_stream(uint64_t b, uint64_t e, uint64_t bs){
+
+		//first, write number of integers in the stream
+		flush_gamma_integer(e-b);
+
+		auto bitsizes = this->bitsizes(b,e,bs);
+
+		auto blocks_bitsizes = bitsizes;
+
+		//delta-encode bitsizes
 		delta_encode(blocks_bitsizes);
 		//run-length encode the deltas
 		auto R = run_length_encode(blocks_bitsizes);
@@ -377,9 +555,7 @@ private:
 		for(auto x:R2.second) flush_gamma_integer(x);
 
 		//flush all integers using bitsize of their block
-		for(uint64_t i=0;i<buffer.size();++i) flush_binary_integer(buffer[i],bitsizes[i/block_size]);
-
-		flush_bits();
+		for(uint64_t i=b;i<e;++i) flush_binary_integer(buffer[i],bitsizes[(i-b)/bs]);
 
 	}
 
@@ -545,11 +721,35 @@ private:
 
 		assert(buffer.size()==0);
 
-		//number of integers stored in the file
 		uint64_t n = read_next_gamma();
 
+		//single stream with blocks of size block_size
+		if(n != 1){
+
+			read_stream(n,block_size);
+			return;
+
+		}
+
+		uint64_t n_streams = read_next_gamma();
+
+		for(uint64_t s=0;s<n_streams;++s){
+
+			uint64_t bs = read_next_gamma();
+
+			read_stream(read_next_gamma(),bs);
+
+		}
+
+	}
+
+	/*
+	 * decode a stream of n integers with blocks of size bs (its size has already been read)
+	 */
+	void read_stream(uint64_t n, uint64_t bs){
+
 		//number of stored bit-sizes
-		uint64_t n_blocks = (n/block_size) + (n%block_size!=0);
+		uint64_t n_blocks = (n/bs) + (n%bs!=0);
 
 		//number of R's runs
 		uint64_t R_size = read_next_gamma();
@@ -574,13 +774,40 @@ private:
 
 		delta_decode(V);
 
-		//now read n integers
-		for(itype i=0;i<n;++i){
+		//now read n integers, with a loop specialized for the block size
+		switch(bs){
+
+			case 2: read_blocks<2>(n,V); break;
+			case 4: read_blocks<4>(n,V); break;
+			case 6: read_blocks<6>(n,V); break;
+			case 8: read_blocks<8>(n,V); break;
+			case 12: read_blocks<12>(n,V); break;
+			case 16: read_blocks<16>(n,V); break;
+			case 32: read_blocks<32>(n,V); break;
+			case 64: read_blocks<64>(n,V); break;
+			default: for(uint64_t i=0;i<n;++i) buffer.push_back(read_next_int(V[i/bs])); break;
 
-			buffer.push_back(read_next_int(V[i/block_size]));
+		}
+
+	}
+
+	/*
+	 * read n integers stored in blocks of bs integers, V[k] being the bit-width of the k-th block
+	 */
+	template<uint64_t bs>
+	void read_blocks(uint64_t n, const vector<itype> & V){
+
+		uint64_t full = n/bs;
+
+		for(uint64_t k=0;k<full;++k){
+
+			auto w = V[k];
+			for(uint64_t j=0;j<bs;++j) buffer.push_back(read_next_int(w));
 
 		}
 
+		for(uint64_t i=full*bs;i<n;++i) buffer.push_back(read_next_int(V[full]));
+
 	}
 
 	/*
@@ -667,6 +894,15 @@ private:
 
 	}
 
+	/*
+	 * length of the gamma encoding of x
+	 */
+	uint64_t gamma_length(uint64_t x){
+
+		return 2*wd(x)-1;
+
+	}
+
 	/*
 	 * return gamma encoding of x
 	 */
@@ -752,7 +988,11 @@ private:
 	vector<itype> buffer;
 	uint64_t idx_in_buf = 0;//current index in buffer while reading
 
-	vector<itype> blocks_bitsizes;//store bitsize of largest integer in each block
+	//candidate block sizes (the decoder has a specialized loop for each of them)
+	const vector<uint64_t> block_sizes = {2,4,6,8,12,16,32,64};
+
+	vector<uint64_t> stream_ends;//end (exclusive) in buffer of each stream
+	vector<uint64_t> chosen_block_sizes;//block size of each stream
 
 
 	bool end_of_file = false;
@@ -771,3 +1011,5 @@ private:
 	uint64_t actual_bitsize = 0;
 
 };
+
+#endif /* INTERNAL_PACKED_GAMMA_FILE3_HPP_ */
@@ -80,8 +80,8 @@ public:
 
 		if(ab==nullpair) return false;
 
-		assert(ab.first < H.size());
-		assert(ab.second < H.size());
+		//symbols outside the table cannot be part of stored pairs
+		if(ab.first >= H.size() or ab.second >= H.size()) return false;
 
 		return H[ab.first][ab.second] != null;
 
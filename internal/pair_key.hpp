@@ -0,0 +1,85 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * pair_key.hpp
+ *
+ *  Created on: Mar 21, 2017
+ *      Author: nico
+ *
+ *  packed 64-bit key of a pair of symbols ab: a in the high 32 bits, b in the low 32 bits.
+ *  Text symbols are smaller than 2^32 (skippable_text stores at most 32 bits per character), so
+ *  the key is exact for 32-bit and 64-bit symbol types alike. The blank pair <BLANK,BLANK>
+ *  (BLANK = ~0) is mapped to NULLKEY = ~0 for both types.
+ *
+ *  Keys are compared with a single 64-bit comparison and hashed with pair_key_hash (the 64-bit
+ *  finalizer of MurmurHash3: every bit of a and b affects every bit of the hash).
+ *
+ */
+
+#ifndef INTERNAL_PAIR_KEY_HPP_
+#define INTERNAL_PAIR_KEY_HPP_
+
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+typedef uint64_t pair_key_t;
+
+const pair_key_t NULLKEY = ~pair_key_t(0);
+
+inline pair_key_t pack_pair(uint64_t a, uint64_t b){
+
+	return (a << 32) | uint32_t(b);
+
+}
+
+inline uint64_t key_first(pair_key_t ab){
+	return ab >> 32;
+}
+
+inline uint64_t key_second(pair_key_t ab){
+	return uint32_t(ab);
+}
+
+/*
+ * inverse of pack_pair (NULLKEY is mapped back to the blank pair of ctype)
+ */
+template<typename ctype>
+pair<ctype,ctype> unpack_pair(pair_key_t ab){
+
+	if(ab == NULLKEY) return {~ctype(0),~ctype(0)};
+
+	return {ctype(key_first(ab)),ctype(key_second(ab))};
+
+}
+
+struct pair_key_hash{
+
+	std::size_t operator()(pair_key_t x) const{
+
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+
+		return x;
+
+	}
+
+};
+
+#endif /* INTERNAL_PAIR_KEY_HPP_ */
@@ -0,0 +1,477 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * posting_lists.hpp
+ *
+ *  Created on: Mar 14, 2017
+ *      Author: nico
+ *
+ *  grammar-compressed set of sorted integer lists (e.g. inverted-index posting lists).
+ *
+ *  Input format: one list per line, non-decreasing integers separated by white space. Lists are
+ *  gap-encoded (the first gap is the first element) and concatenated, each followed by a terminator
+ *  symbol that Re-Pair never pairs: every list is thus a range of the compressed text Tc.
+ *
+ *  Symbols < 2^16 are needed by the engine, so a symbol is a (value, emits) pair: a gap g gets its own
+ *  symbol <g, 1> if g < 256 or g is among the most frequent gaps; otherwise g is written as symbols
+ *  <2^j, 0> (carries, which add to the sum but do not produce an element), one for each bit j >= 8 of g,
+ *  followed by <g mod 256, 1>. Symbol 0 is the terminator.
+ *
+ *  For every grammar symbol X we store the sum of the values in its expansion, the number of elements it
+ *  produces and the offset (sum of values) of its last element. For every Tc position we store the sum of
+ *  the values before it inside its list. Then:
+ *
+ *  decode_list(i): the i-th list. Complexity: O(list length)
+ *  next_geq(i,x): smallest element >= x in the i-th list. Complexity: O(log |Tc| + h), h = grammar height
+ *
+ *  The layout (stored in section RP_SECTION_POSTINGS) is
+ *
+ *  	<number of lists, D, emits_0, value_0, ..., emits_{D-1}, value_{D-1}>
+ *
+ *  where D is the number of symbols.
+ *
+ */
+
+#ifndef INTERNAL_POSTING_LISTS_HPP_
+#define INTERNAL_POSTING_LISTS_HPP_
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rp_archive.hpp"
+#include "crc32c.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class posting_lists{
+
+public:
+
+	using ipair = pair<itype,itype>;
+
+	static const uint64_t none = ~uint64_t(0);
+
+	//the list terminator
+	static const itype TERMINATOR = 0;
+
+	posting_lists(){}
+
+	/*
+	 * load the lists stored in archive arc (its A, G and T are moved)
+	 */
+	posting_lists(rp_archive<itype> & arc){
+
+		A.swap(arc.A);
+		G.swap(arc.G);
+		Tc.swap(arc.T);
+
+		auto & payload = arc.section(RP_SECTION_POSTINGS);
+
+		n_lists = payload[0];
+		uint64_t D = payload[1];
+
+		assert(payload.size() == 2+2*D);
+
+		for(uint64_t s=0;s<D;++s) symbols.push_back({payload[2+2*s] == 1, payload[3+2*s]});
+
+		itype sigma = A.size();
+
+		sum = vector<uint64_t>(sigma+G.size());
+		cnt = vector<uint64_t>(sigma+G.size());
+		last = vector<uint64_t>(sigma+G.size());
+
+		for(itype X=0;X<sigma+G.size();++X){
+
+			if(X < sigma){
+
+				auto s = symbols[A[X]];
+
+				sum[X] = s.second;
+				cnt[X] = s.first;
+				last[X] = s.second;
+
+			}else{
+
+				ipair ab = G[X-sigma];
+
+				assert(ab.first < X and ab.second < X);
+
+				sum[X] = sum[ab.first] + sum[ab.second];
+				cnt[X] = cnt[ab.first] + cnt[ab.second];
+				last[X] = cnt[ab.second] > 0 ? sum[ab.first] + last[ab.second] : last[ab.first];
+
+			}
+
+		}
+
+		//list boundaries and sums before each Tc position inside its list
+		begin.push_back(0);
+		cum = vector<uint64_t>(Tc.size()+1,0);
+
+		for(uint64_t j=0;j<Tc.size();++j){
+
+			bool terminator = Tc[j] < sigma and A[Tc[j]] == TERMINATOR;
+
+			cum[j+1] = terminator ? 0 : cum[j] + sum[Tc[j]];
+
+			if(terminator) begin.push_back(j+1);
+
+		}
+
+		assert(begin.size() == n_lists+1);
+
+	}
+
+	/*
+	 * parse the lists in stream in. Return the sequence of symbols to be compressed; the layout
+	 * and the CRC32C of the lists' text (see expand) are stored in this object
+	 */
+	vector<itype> encode(istream & in){
+
+		vector<vector<uint64_t> > gaps;
+
+		string line;
+
+		while(std::getline(in,line)){
+
+			std::istringstream ss(line);
+
+			gaps.push_back({});
+
+			uint64_t prev = 0;
+			uint64_t x;
+
+			while(ss >> x){
+
+				if(x < prev or x > ~itype(0)){
+
+					cout << "Error: list " << gaps.size()-1 << " is not sorted or contains a value larger than " << ~itype(0) << endl;
+					exit(1);
+
+				}
+
+				gaps.back().push_back(x - prev);
+				prev = x;
+
+			}
+
+			string text = render(gaps.back(),true);
+
+			text_crc = crc32c::update(text_crc,(const uint8_t*)text.data(),text.size());
+			text_length += text.size();
+
+		}
+
+		n_lists = gaps.size();
+
+		//gaps >= 256 that get their own symbol: the most frequent ones
+		unordered_map<uint64_t,uint64_t> freq;
+
+		for(auto & l : gaps) for(auto g : l) if(g >= 256) freq[g]++;
+
+		vector<pair<uint64_t,uint64_t> > frequent; //<-frequency, gap>
+
+		for(auto f : freq) if(f.second >= 2) frequent.push_back({-f.second,f.first});
+
+		freq = {};
+
+		std::sort(frequent.begin(),frequent.end());
+
+		//keep room for the terminator, small gaps and carries
+		if(frequent.size() > MAX_SYMBOLS-256-65) frequent.resize(MAX_SYMBOLS-256-65);
+
+		map<pair<bool,uint64_t>,itype> id;
+
+		symbols = {{false,0}};
+		id[symbols[0]] = TERMINATOR;
+
+		auto symbol = [&](bool emits, uint64_t value){
+
+			auto it = id.find({emits,value});
+
+			if(it == id.end()){
+
+				it = id.insert({{emits,value},itype(symbols.size())}).first;
+				symbols.push_back({emits,value});
+
+			}
+
+			return it->second;
+
+		};
+
+		for(auto f : frequent) symbol(true,f.second);
+
+		unordered_map<uint64_t,bool> is_frequent;
+		for(auto f : frequent) is_frequent[f.second] = true;
+
+		frequent = {};
+
+		vector<itype> S;
+
+		for(auto & l : gaps){
+
+			for(auto g : l){
+
+				if(g < 256 or is_frequent.count(g) == 1){
+
+					S.push_back(symbol(true,g));
+
+				}else{
+
+					for(int j=63;j>=8;--j) if((g >> j) & 1) S.push_back(symbol(false,uint64_t(1)<<j));
+
+					S.push_back(symbol(true,g & 255));
+
+				}
+
+			}
+
+			l = {};
+
+			S.push_back(TERMINATOR);
+
+		}
+
+		return S;
+
+	}
+
+	/*
+	 * serialize the layout (payload of section RP_SECTION_POSTINGS)
+	 */
+	vector<itype> serialize(){
+
+		vector<itype> payload = {itype(n_lists), itype(symbols.size())};
+
+		for(auto s : symbols){
+
+			payload.push_back(s.first);
+			payload.push_back(s.second);
+
+		}
+
+		return payload;
+
+	}
+
+	uint64_t number_of_lists(){
+		return n_lists;
+	}
+
+	/*
+	 * number of elements of the i-th list
+	 */
+	uint64_t list_length(uint64_t i){
+
+		assert(i < n_lists);
+
+		uint64_t l = 0;
+		for(uint64_t j=begin[i];j+1<begin[i+1];++j) l += cnt[Tc[j]];
+
+		return l;
+
+	}
+
+	/*
+	 * the i-th list
+	 */
+	vector<uint64_t> decode_list(uint64_t i){
+
+		assert(i < n_lists);
+
+		vector<uint64_t> L;
+
+		uint64_t acc = 0;
+		vector<itype> S;
+
+		//the last symbol of the range is the terminator
+		for(uint64_t j=begin[i];j+1<begin[i+1];++j){
+
+			S.push_back(Tc[j]);
+
+			while(not S.empty()){
+
+				itype X = S.back();
+				S.pop_back();
+
+				if(X < A.size()){
+
+					acc += sum[X];
+					if(cnt[X] > 0) L.push_back(acc);
+
+				}else{
+
+					ipair ab = G[X-A.size()];
+
+					S.push_back(ab.second);
+					S.push_back(ab.first);
+
+				}
+
+			}
+
+		}
+
+		return L;
+
+	}
+
+	/*
+	 * smallest element >= x of the i-th list, or none if there is no such element
+	 */
+	uint64_t next_geq(uint64_t i, uint64_t x){
+
+		assert(i < n_lists);
+
+		uint64_t b = begin[i];
+		uint64_t e = begin[i+1]-1; //position of the terminator
+
+		//first Tc position j in [b,e) such that the sum up to the end of Tc[j] is >= x
+		uint64_t j = std::lower_bound(cum.begin()+b+1,cum.begin()+e+1,x) - cum.begin() - 1;
+
+		//the element may be in a following symbol if Tc[j] ends with carries
+		for(;j<e;++j){
+
+			itype X = Tc[j];
+			uint64_t acc = cum[j];
+
+			if(cnt[X] == 0 or acc + last[X] < x) continue;
+
+			//descend: the answer is inside X
+			while(X >= A.size()){
+
+				ipair ab = G[X-A.size()];
+
+				if(cnt[ab.first] > 0 and acc + last[ab.first] >= x){
+
+					X = ab.first;
+
+				}else{
+
+					acc += sum[ab.first];
+					X = ab.second;
+
+				}
+
+			}
+
+			return acc + sum[X];
+
+		}
+
+		return none;
+
+	}
+
+	/*
+	 * write the lists to ofs, one per line (elements separated by a space)
+	 */
+	void expand(ofstream & ofs){
+
+		for(uint64_t i=0;i<n_lists;++i){
+
+			auto line = render(decode_list(i));
+			ofs.write(line.c_str(),line.size());
+
+		}
+
+	}
+
+	/*
+	 * CRC32C and length of the text written by expand, computed by decoding all lists
+	 */
+	pair<uint32_t,uint64_t> crc32c(){
+
+		uint32_t c = 0;
+		uint64_t l = 0;
+
+		for(uint64_t i=0;i<n_lists;++i){
+
+			auto line = render(decode_list(i));
+
+			c = crc32c::update(c,(const uint8_t*)line.data(),line.size());
+			l += line.size();
+
+		}
+
+		return {c,l};
+
+	}
+
+	//CRC32C and length of the lists' text, computed by encode
+	uint32_t text_crc = 0;
+	uint64_t text_length = 0;
+
+private:
+
+	static const itype MAX_SYMBOLS = itype(1)<<15;
+
+	/*
+	 * text of a list (as elements or as gaps): elements separated by a space, then a newline
+	 */
+	string render(const vector<uint64_t> & L, bool gaps = false){
+
+		string s;
+		uint64_t x = 0;
+
+		for(uint64_t k=0;k<L.size();++k){
+
+			x = gaps ? x + L[k] : L[k];
+
+			if(k > 0) s.push_back(' ');
+			s.append(std::to_string(x));
+
+		}
+
+		s.push_back('\n');
+
+		return s;
+
+	}
+
+	uint64_t n_lists = 0;
+
+	//<emits, value> of every input symbol
+	vector<pair<bool,uint64_t> > symbols;
+
+	vector<itype> A;
+	vector<ipair> G;
+	vector<itype> Tc;
+
+	//per grammar symbol: sum of values, number of elements, sum of values up to the last element
+	vector<uint64_t> sum;
+	vector<uint64_t> cnt;
+	vector<uint64_t> last;
+
+	//begin[i] = first Tc position of the i-th list
+	vector<uint64_t> begin;
+
+	//cum[j] = sum of the values of Tc[b, ..., j-1], b = first position of Tc[j-1]'s list
+	vector<uint64_t> cum;
+
+};
+
+template<typename itype> const uint64_t posting_lists<itype>::none;
+template<typename itype> const itype posting_lists<itype>::TERMINATOR;
+template<typename itype> const itype posting_lists<itype>::MAX_SYMBOLS;
+
+#endif /* INTERNAL_POSTING_LISTS_HPP_ */
@@ -0,0 +1,1420 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * re_pair.hpp
+ *
+ *  Created on: Jan 11, 2017
+ *      Author: nico
+ *
+ *  the Re-Pair compressor: computes the grammar <A, G, T_vec> of a text using roughly 6n Bytes of RAM.
+ *  Objects are independent, so several texts can be compressed in parallel by different objects.
+ *
+ */
+
+#ifndef INTERNAL_RE_PAIR_HPP_
+#define INTERNAL_RE_PAIR_HPP_
+
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+#include <lf_queue.hpp>
+#include <hf_queue.hpp>
+#include <ll_el.hpp>
+
+#include "skippable_text.hpp"
+#include "text_positions.hpp"
+#include "pair_key.hpp"
+#include "rule_order.hpp"
+#include "crc32c.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t, typename ll_el_t = ll_el<itype,itype> >
+class re_pair{
+
+public:
+
+	//high/low frequency text type
+	using text_t = skippable_text<itype,itype>;
+	using TP_t = text_positions<itype,itype,ll_el_t>;
+	using hf_q_t = hf_queue<ll_el_t,itype,itype>;
+	using lf_q_t = lf_queue<ll_el_t>;
+
+	using cpair = typename hf_q_t::cpair;
+
+	/*
+	 * if verbose = false, the object does not print anything to standard output
+	 */
+	re_pair(bool verbose = true) : msg(verbose ? cout.rdbuf() : nullptr) {}
+
+	/*
+	 * compute the grammar of the content of file in
+	 */
+	void compress(string in){
+
+		itype n;
+
+		//count file size
+		{
+			ifstream file(in,ios::ate);
+			n = file.tellg();
+		}
+
+		ifstream ifs(in);
+
+		compute_repair(ifs, n);
+
+	}
+
+	/*
+	 * compute the grammar of the n characters read from stream ifs
+	 */
+	void compress(istream & ifs, itype n){
+
+		compute_repair(ifs, n);
+
+	}
+
+	/*
+	 * compute the grammar of a sequence of integer symbols, each < 2^16 (e.g. token ids). S is any container
+	 * with size() and operator[]. A[X] is then the input symbol of terminal X. text_crc and text_length are
+	 * not computed: they are left to the caller, which knows the text the symbols stand for. S is cleared.
+	 *
+	 * If known, pair_freq[a*d+b] is the number of positions i with S[i] = a and S[i+1] = b, for some d larger
+	 * than all symbols (pair_freq has d^2 entries): then the pairs are not counted again when building the text
+	 * positions.
+	 */
+	template<typename seq_t>
+	void compress_symbols(seq_t & S, const vector<uint64_t> & pair_freq = {}){
+
+		compute_repair(S, pair_freq);
+
+	}
+
+	vector<itype> A; //alphabet (mapping int->ascii)
+	vector<pair<itype, itype> > G; //grammar
+	vector<itype> T_vec;// compressed text
+
+	uint32_t text_crc = 0; //CRC32C of the input text
+	itype text_length = 0;
+
+	/*
+	 * optional hooks. on_progress is called with the fraction of work done (in [0,1]). If cancel is set,
+	 * compression stops at the next substitution round after *cancel becomes true: then cancelled() returns
+	 * true and <A, G, T_vec> is incomplete.
+	 */
+	function<void(double)> on_progress;
+	const atomic<bool> * cancel = nullptr;
+
+	/*
+	 * compress_symbols only: input symbol that is never paired, so that no rule contains it (e.g. a list
+	 * terminator). It then appears only in T_vec
+	 */
+	itype separator = ~itype(0);
+
+	/*
+	 * if > 1, the low-frequency phase first runs on lf_threads segments of the text in parallel (each
+	 * with its own text positions and queue), rules equal across segments are merged and a final
+	 * sequential pass replaces the pairs that are still repeated (e.g. across segment boundaries).
+	 * Segments build different rules for the same strings, so the grammar can be much larger than the
+	 * sequential one (+15% on logs with 4 segments, see README). Uses about one more copy of the text in RAM
+	 */
+	unsigned lf_threads = 1;
+
+	/*
+	 * if > 0, rules higher than max_height are never created (terminals have height 0, rule X -> ab has
+	 * height 1 + max(height(a), height(b))): their pairs stay in the compressed text. Random access and
+	 * decompression then descend at most max_height levels, at some cost in compression ratio
+	 */
+	itype max_height = 0;
+
+	/*
+	 * a text position list is synchronized (clustered again) when at most 1/sync_ratio of its entries
+	 * still hold its pair (see synchro_or_remove_pair). With values > 2, lists are synchronized less
+	 * often, but pairs created by the replacements are found later, so a round may not replace the most
+	 * frequent pair and the grammar can be larger (see README)
+	 */
+	itype sync_ratio = 2;
+
+	/*
+	 * if true, when every occurrence of a new symbol is followed by the same symbols (a long repeat), the
+	 * rules for the rest of the repeat are created in the same round (see collapse_chain). The grammar
+	 * is then not the one of exact Re-Pair, and on most inputs it is larger and higher (see README)
+	 */
+	bool collapse_chains = false;
+
+	bool cancelled(){
+		return stopped;
+	}
+
+private:
+
+	bool stop(){
+
+		stopped = stopped or (cancel != nullptr and cancel->load());
+		return stopped;
+
+	}
+
+	void progress(double p){
+
+		if(on_progress) on_progress(p);
+
+	}
+
+	/*
+	 * false iff ab contains the separator or its rule would be higher than max_height
+	 */
+	bool pairable(cpair ab){
+
+		if(max_height > 0 and 1 + std::max(height_of(ab.first),height_of(ab.second)) > max_height) return false;
+
+		return ab.first != sep and ab.second != sep;
+
+	}
+
+	/*
+	 * height of text symbol s (symbols without a recorded height are terminals)
+	 */
+	itype height_of(itype s){
+
+		return s < height.size() ? height[s] : 0;
+
+	}
+
+	/*
+	 * record the height of new rule X -> ab
+	 */
+	void set_height(itype X, cpair ab){
+
+		if(height.size() <= X) height.resize(uint64_t(X)+1,0);
+
+		height[X] = 1 + std::max(height_of(ab.first),height_of(ab.second));
+
+	}
+
+	/*
+	 * Given (empty) queue, text positions, text, and minimum frequency: insert in Q all pairs with frequency at least min_freq.
+	 *
+	 * assumptions: TP is sorted by character pairs, Q is void
+	 *
+	 */
+	void new_high_frequency_queue(hf_q_t & Q, TP_t & TP, text_t & T, uint64_t min_freq){
+
+		itype j = 0; //current position on TP
+		itype n = TP.size();
+
+		int old_perc = 0;
+		int perc;
+
+		itype n_pairs = 0;
+
+		/*
+		 * step 1: count number of high-freq pairs
+		 */
+		while(j<n){
+
+			itype k = 1; //current pair frequency
+
+			while(	j<TP.size()-1 &&
+					T.key_starting_at(TP[j]) != NULLKEY &&
+					T.key_starting_at(TP[j]) == T.key_starting_at(TP[j+1]) ){
+
+				j++;
+				k++;
+
+			}
+
+			if(k>=min_freq){
+
+				n_pairs++;
+
+			}
+
+			j++;
+
+		}
+
+		//largest possible dictionary symbol
+		itype max_d = X+T.size()/min_freq;
+
+		//create new queue. Capacity is number of pairs / min_frequency
+		Q.init(max_d,min_freq);
+
+		/*
+		 * step 2. Fill queue
+		 */
+		j = 0;
+		while(j<n){
+
+			itype P_ab = j; //starting position in TP of pair
+
+			itype k = 1; //current pair frequency
+			pair_key_t key = NULLKEY;
+
+			while(	j<TP.size()-1 &&
+					T.key_starting_at(TP[j]) != NULLKEY &&
+					T.key_starting_at(TP[j]) == T.key_starting_at(TP[j+1]) ){
+
+				key = T.key_starting_at(TP[j]);
+
+				j++;
+				k++;
+
+			}
+
+			cpair ab = unpack_pair<itype>(key);
+
+			if(k>=min_freq and pairable(ab)){
+
+				Q.insert({ab, P_ab, k, k});
+
+			}
+
+			j++;
+
+		}
+
+	}
+
+
+	/*
+	 * synchronize queue in range corresponding to pair AB.
+	 */
+	template<typename queue_t>
+	void synchronize(queue_t & Q, TP_t & TP, text_t & T, cpair AB){
+
+		//variables associated with AB
+		assert(Q.contains(AB));
+		auto q_el = Q[AB];
+		itype P_AB = q_el.P_ab;
+		itype L_AB = q_el.L_ab;
+		itype F_AB = q_el.F_ab;
+
+		itype freq_AB = 0;//number of pairs AB seen inside the interval. Computed inside this function
+
+		assert(P_AB+L_AB <= TP.size());
+		//sort sub-array corresponding to AB
+		TP.cluster(P_AB,P_AB+L_AB);
+		assert(TP.is_clustered(P_AB,P_AB+L_AB));
+
+		//scan TP[P_AB,...,P_AB+L_AB-1] and detect new pairs (comparing packed pair keys)
+		pair_key_t ab = pack_pair(AB.first,AB.second);
+
+		itype j = P_AB;//current position in TP
+		while(j<P_AB+L_AB){
+
+			itype p = j; //starting position of current pair in TP
+			itype k = 1; //current pair frequency
+
+			pair_key_t xy = T.key_starting_at(TP[j]);
+
+			while(	j<(P_AB+L_AB)-1 &&
+					xy != NULLKEY &&
+					xy == T.key_starting_at(TP[j+1]) ){
+
+				j++;
+				k++;
+
+			}
+
+			freq_AB = xy == ab ? k : freq_AB;
+
+			if(k >= Q.minimum_frequency()){
+
+				cpair XY = unpack_pair<itype>(xy);
+
+				//if the pair is not AB and it is a high-frequency pair, insert it in queue
+				if(xy != ab and pairable(XY)){
+
+					assert(XY != T.blank_pair());
+
+					assert(not Q.contains(XY));
+
+					Q.insert({XY,p,k,k});
+
+					assert(TP.contains_only(p,p+k,xy));
+
+				}else if(xy == ab){ //the pair is AB and is already in the queue: update its frequency
+
+					assert(Q.contains(AB));
+					Q.update({AB,p,k,k});
+
+					assert(TP.contains_only(p,p+k,ab));
+
+				}
+
+			}
+
+			j++;
+
+		}
+
+		assert(Q.contains(AB));
+
+		//it could be that now AB's frequency is too small: delete it
+		if(freq_AB < Q.minimum_frequency()){
+
+			Q.remove(AB);
+
+		}
+
+		assert(not Q.contains(AB) || Q[AB].F_ab == Q[AB].L_ab);
+
+	}
+
+
+	/*
+	 * look at F_ab and L_ab (with r = sync_ratio). Cases:
+	 *
+	 * 1. F_ab <= L_ab/r and F_ab >= min_freq: synchronize pair. There could be new high-freq pairs in ab's list
+	 * 2. F_ab <= L_ab/r and F_ab < min_freq: as above. This because there could be new high-freq pairs in ab's list.
+	 * 3. F_ab > L_ab/r and F_ab >= min_freq: do nothing
+	 * 4. F_ab > L_ab/r and F_ab < min_freq: remove ab if its list has less than min_freq stale entries (always
+	 *    the case for r = 2): then it cannot contain high-freq pairs, so it is safe to lose references to these
+	 *    pairs. Otherwise, synchronize.
+	 */
+	template<typename queue_t>
+	void synchro_or_remove_pair(queue_t & Q, TP_t & TP, text_t & T, cpair ab){
+
+		assert(Q.contains(ab));
+
+		auto q_el = Q[ab];
+		itype F_ab = q_el.F_ab;
+		itype L_ab = q_el.L_ab;
+
+		if(F_ab <= L_ab/sync_ratio){
+
+			synchronize<queue_t>(Q, TP, T, ab);
+
+		}else{
+
+			if(F_ab < Q.minimum_frequency()){
+
+				if(L_ab - F_ab < Q.minimum_frequency()){
+
+					Q.remove(ab);
+
+				}else{
+
+					synchronize<queue_t>(Q, TP, T, ab);
+
+				}
+
+			}
+
+		}
+
+	}
+
+
+	/*
+	 * AB has just been replaced with X at positions occ. If every occurrence of X is followed by the same
+	 * symbols C1 ... Ck, the string X C1 ... Ck occurs at these f positions, and the k rules for it that k
+	 * more rounds would create are created now, in this round. Adjacent symbols are paired level by level
+	 * (a tree of height about log k, not a chain X C1, (X C1) C2, ...) and X is advanced to the root, which
+	 * replaces the occurrences.
+	 *
+	 * Only the pairs containing X are confined to the chains. An inner pair <Ct,Ct+1> may also occur
+	 * elsewhere in the text, so its frequency in Q is decreased by f (its chain occurrences) and the other
+	 * occurrences are left to later rounds. The pairs <B,C1>, ..., <Ck-1,Ck> that disappeared are appended
+	 * to chain_pairs. Return Ck (AB.second if there is no chain)
+	 */
+	template<typename queue_t>
+	itype collapse_chain(queue_t & Q, text_t & T, cpair AB, const vector<itype> & occ, vector<cpair> & chain_pairs){
+
+		itype f = occ.size();
+
+		//under a height bound, separate rounds choose the pairs that still fit
+		if(not collapse_chains or f < 2 or max_height > 0) return AB.second;
+
+		//the chain X C1 ... Ck. In occurrence o, S[t] is at position pos[t*f+o]
+		vector<itype> S = {X};
+		vector<itype> pos(occ);
+		vector<itype> next(f);
+
+		while(true){
+
+			bool chain = true;
+
+			for(itype o=0;o<f and chain;++o){
+
+				next[o] = T.next_position(pos[(S.size()-1)*f+o]);
+				chain = next[o] < T.size() and T[next[o]] == T[next[0]];
+
+			}
+
+			if(not chain or T[next[0]] == X or T[next[0]] == sep) break;
+
+			S.push_back(T[next[0]]);
+			pos.insert(pos.end(),next.begin(),next.end());
+
+		}
+
+		if(S.size() == 1) return AB.second;
+
+		//<B,C1> has already been decreased with the replacement of AB
+		chain_pairs.push_back({AB.second,S[1]});
+
+		for(uint64_t t=2;t<S.size();++t){
+
+			cpair p = {S[t-1], S[t]};
+
+			if(Q.contains(p) && p != AB) for(itype o=0;o<f;++o) Q.decrease(p);
+
+			chain_pairs.push_back(p);
+
+		}
+
+		itype last = S.back();
+
+		//pairs <Ck,y> after the chain (synchronized by the caller)
+		for(itype o=0;o<f;++o){
+
+			cpair p = T.pair_starting_at(pos[(S.size()-1)*f+o]);
+
+			if(Q.contains(p) && p != AB) Q.decrease(p);
+
+		}
+
+		//pair adjacent symbols level by level. idx[t] = index in S of the leftmost symbol below level[t]
+		vector<itype> level(S);
+		vector<itype> idx(S.size());
+
+		for(uint64_t t=0;t<S.size();++t) idx[t] = t;
+
+		while(level.size() > 1){
+
+			vector<itype> level1;
+			vector<itype> idx1;
+
+			for(uint64_t t=0;t+1<level.size();t+=2){
+
+				cpair ab = {level[t],level[t+1]};
+
+				G.push_back(ab);
+				X++;
+
+				if(max_height > 0) set_height(X,ab);
+
+				for(itype o=0;o<f;++o) T.replace(pos[idx[t]*f+o],X);
+
+				level1.push_back(X);
+				idx1.push_back(idx[t]);
+
+				n_chain_rules++;
+
+			}
+
+			if(level.size() % 2 == 1){
+
+				level1.push_back(level.back());
+				idx1.push_back(idx.back());
+
+			}
+
+			level.swap(level1);
+			idx.swap(idx1);
+
+		}
+
+		return last;
+
+	}
+
+	/*
+	 * return frequency of replaced pair
+	 */
+	template<typename queue_t>
+	uint64_t substitution_round(queue_t & Q, TP_t & TP, text_t & T){
+
+		using ctype = typename text_t::char_type;
+
+		//compute max
+		cpair AB = Q.max();
+
+		G.push_back(AB);
+
+		if(max_height > 0) set_height(X,AB);
+
+		//msg << "MAX freq = " << Q[AB].F_ab << endl;
+
+		assert(Q.contains(AB));
+		assert(Q[AB].F_ab >= Q.minimum_frequency());
+
+		//extract P_AB and L_AB
+		auto q_el = Q[AB];
+		itype F_AB = q_el.F_ab;
+		itype P_AB = q_el.P_ab;
+		itype L_AB = q_el.L_ab;
+
+		uint64_t f_replaced = F_AB;
+
+		n_distinct_freqs += (F_AB != last_freq);
+		last_freq = F_AB;
+
+		pair_key_t ab = pack_pair(AB.first,AB.second);
+
+		vector<itype> occ; //positions of X
+
+		for(itype j = P_AB; j<P_AB+L_AB;++j){
+
+			itype i = TP[j];
+
+			if(T.key_starting_at(i) == ab){
+
+				occ.push_back(i);
+
+				ctype A = AB.first;
+				ctype B = AB.second;
+
+				//the context of AB is xABy. We now extract AB's context:
+				cpair xA = T.pair_ending_at(i);
+				cpair By = T.next_pair(i);
+
+				assert(xA == T.blank_pair() or xA.second == A);
+				assert(By == T.blank_pair() or By.first == B);
+
+				//note: xA and By could be blank pairs if this AB was the first/last pair in the text
+
+				//perform replacement
+				T.replace(i,X);
+
+				assert(By == T.blank_pair() || T.pair_starting_at(i) == cpair(X,By.second));
+
+				if(Q.contains(xA) && xA != AB){
+
+					Q.decrease(xA);
+
+				}
+
+				if(Q.contains(By) && By != AB){
+
+					Q.decrease(By);
+
+				}
+
+			}
+
+		}
+
+		//pairs <last symbol of X's expansion, next symbol> that disappeared inside a chain (see collapse_chain)
+		vector<cpair> chain_pairs;
+		ctype last = collapse_chain<queue_t>(Q, T, AB, occ, chain_pairs);
+
+		/*
+		 * re-scan text positions associated to AB and synchronize if needed
+		 */
+		for(itype j = P_AB; j<P_AB+L_AB;++j){
+
+			itype i = TP[j];
+
+			assert(T.key_starting_at(i) != ab); //we replaced all ABs ...
+
+			if(T[i] == X){
+
+				//the context of X is xXy. We now extract X's left (x) and right (y) contexts:
+				cpair xX = T.pair_ending_at(i);
+				cpair Xy = T.pair_starting_at(i);
+
+				ctype A = AB.first;
+				ctype B = last; //last symbol replaced by X (AB.second, unless a chain was collapsed)
+
+				//careful: x and y could be = X. in this case, before the replacements this xX was equal to ABAB -> a BA disappeared
+				ctype x = xX.first == X ? B : xX.first;
+				ctype y = Xy.second == X ? A : Xy.second;
+
+				//these are the pairs that disappeared
+				cpair xA = xX == T.blank_pair() ? xX : cpair {x,A};
+				cpair By = Xy == T.blank_pair() ? Xy : cpair {B,y};
+
+				if(Q.contains(By) && By != AB){
+
+					synchro_or_remove_pair<queue_t>(Q, TP, T, By);
+
+				}
+
+				if(Q.contains(xA) && xA != AB){
+
+					synchro_or_remove_pair<queue_t>(Q, TP, T, xA);
+
+				}
+
+			}
+
+		}
+
+		for(auto p : chain_pairs){
+
+			if(Q.contains(p) && p != AB) synchro_or_remove_pair<queue_t>(Q, TP, T, p);
+
+		}
+
+		assert(Q.contains(AB));
+		synchronize<queue_t>(Q, TP, T, AB); //automatically removes AB since new AB's frequency is 0
+		assert(not Q.contains(AB));
+
+		//advance next free dictionary symbol
+		X++;
+
+		//msg << " current text size = " << T.number_of_non_blank_characters() << endl << endl;
+
+		return f_replaced;
+
+	}
+
+
+	void compute_repair(istream & ifs, itype n){
+
+		/*
+		 * tradeoff between low-frequency and high-freq phase:
+		 *
+		 * - High-freq phase will use n^(2 - 2*alpha) words of memory and process approximately n^(1-alpha) pairs
+		 *   alpha should satisfy 0.5 < alpha < 1
+		 *
+		 * - Low-freq phase will use n^alpha words of memory
+		 *
+		 */
+		double alpha = 0.66; // = 2/3
+
+		/*
+		 * in the low-frequency pair processing phase, insert at most n/B elements in the hash
+		 */
+		uint64_t B = 50;
+
+		itype sigma = 0; //alphabet size
+
+		/*
+		 * Pairs with frequency greater than or equal to min_high_frequency are inserted in high-freq queue
+		 */
+		itype min_high_frequency = 0;
+		itype lf_queue_capacity = 0;
+
+		/*
+		 * (1) INITIALIZE DATA STRUCTURES
+		 */
+
+		const itype null = ~itype(0);
+
+		vector<itype> char_to_int(256,null);
+
+		text_length = n;
+
+		if(n < 2){
+
+			//no pairs: the compressed text is the text itself
+			char c;
+
+			while(ifs.get(c)){
+
+				if(char_to_int[uint8_t(c)] == null){
+
+					char_to_int[uint8_t(c)] = sigma++;
+					A.push_back(uint8_t(c));
+
+				}
+
+				T_vec.push_back(char_to_int[uint8_t(c)]);
+				text_crc = crc32c::update(text_crc,uint8_t(c));
+
+			}
+
+			progress(1);
+
+			return;
+
+		}
+
+		min_high_frequency = std::pow(  n, alpha  );// n^(alpha)
+
+		min_high_frequency = min_high_frequency <2 ? 2 : min_high_frequency;
+
+		msg << "Text size = " << n << " characters"  << endl;
+		msg << "cut-off frequency = " << min_high_frequency  << endl;
+
+		itype width = 64 - __builtin_clzll(uint64_t(n));
+
+		//largest possible high-frequency dictionary symbol
+		//at most max_d <= n high-freq dictionary symbols can be created; given that min. freq of
+		//a high-freq dictionary symbol is f=min_high_frequency and that every new dictionary symbol
+		//introduces a blank in the text, we have the inequality max_d * f <= n  <=> max_d <= n/f
+		itype max_d = 256+n/min_high_frequency;
+
+		//msg << "Max high-frequency dictionary symbol = " << max_d << endl << endl;
+
+		//initialize text and text positions
+		text_t T(n);
+
+		itype j = 0;
+
+		msg << "filling skippable text with text characters ... " << flush;
+
+		char c;
+
+		while(ifs.get(c)){
+
+			if(char_to_int[uint8_t(c)] == null){
+
+				char_to_int[uint8_t(c)] = sigma;
+				A.push_back(uint8_t(c));
+				sigma++;
+
+			}
+
+			T.set(j++,char_to_int[uint8_t(c)]);
+
+			text_crc = crc32c::update(text_crc,uint8_t(c));
+
+		}
+
+		msg << "done. " << endl << endl;
+
+		msg << "alphabet size is " << sigma  << endl << endl;
+
+		//next free dictionary symbol = sigma
+		X =  sigma;
+
+		replace_pairs(T, n, min_high_frequency);
+
+		if(stopped) return;
+
+		//collapsed chains break the creation order of the rules expected by the archive encoder
+		if(collapse_chains) sort_rules(G, T_vec, sigma);
+
+	}
+
+	/*
+	 * compute the grammar of the integer sequence S. Terminals are numbered so that the high-frequency phase only
+	 * sees small symbols: the k symbols occurring at least n^alpha times get ids 0, ..., k-1, the high-frequency
+	 * rules get the following (at most n^(1-alpha)) ids and the other terminals are parked above them. This keeps
+	 * the high-frequency queue's sigma x sigma table small for large alphabets. Ids are made canonical (terminals
+	 * 0, ..., sigma-1, then rules) at the end.
+	 */
+	template<typename seq_t>
+	void compute_repair(seq_t & S, const vector<uint64_t> & pair_freq){
+
+		const itype null = ~itype(0);
+
+		itype n = S.size();
+
+		if(n < 2){
+
+			for(itype i=0;i<n;++i){
+
+				itype c = S[i];
+
+				if(std::find(A.begin(),A.end(),c) == A.end()) A.push_back(c);
+
+				T_vec.push_back(std::find(A.begin(),A.end(),c) - A.begin());
+
+			}
+
+			S = seq_t();
+
+			progress(1);
+
+			return;
+
+		}
+
+		itype min_high_frequency = std::pow(n, 0.66);
+		min_high_frequency = min_high_frequency <2 ? 2 : min_high_frequency;
+
+		msg << "Text size = " << n << " symbols"  << endl;
+		msg << "cut-off frequency = " << min_high_frequency  << endl;
+
+		itype max_c = 0;
+		for(itype i=0;i<n;++i) max_c = std::max(max_c,itype(S[i]));
+
+		assert(max_c <= ~uint16_t(0));
+
+		vector<itype> freq(max_c+1,0);
+		for(itype i=0;i<n;++i) freq[S[i]]++;
+
+		itype k = 0; //frequent terminals
+
+		for(auto f : freq) k += f >= min_high_frequency;
+
+		//high-frequency rules are at most n/min_high_frequency
+		itype rare_begin = k + n/min_high_frequency + 1;
+
+		vector<itype> symbol_to_int(max_c+1,null);
+
+		A = {};
+
+		for(itype c = 0;c<=max_c;++c){
+
+			if(freq[c] >= min_high_frequency){
+
+				symbol_to_int[c] = A.size();
+				A.push_back(c);
+
+			}
+
+		}
+
+		for(itype c = 0;c<=max_c;++c){
+
+			if(freq[c] > 0 and freq[c] < min_high_frequency){
+
+				symbol_to_int[c] = rare_begin + (A.size() - k);
+				A.push_back(c);
+
+			}
+
+		}
+
+		freq = {};
+
+		//frequencies of the pairs of frequent terminals, in id order
+		vector<itype> F;
+
+		if(pair_freq.size() > 0){
+
+			uint64_t d = std::sqrt(double(pair_freq.size()));
+
+			assert(d*d == pair_freq.size() and d > max_c);
+
+			F = vector<itype>(uint64_t(k)*k);
+
+			for(itype a=0;a<k;++a)
+				for(itype b=0;b<k;++b)
+					F[a*k+b] = pair_freq[A[a]*d + A[b]];
+
+		}
+
+		itype sigma = A.size();
+
+		rare_end = rare_begin + (sigma - k);
+
+		assert(rare_end <= ~uint16_t(0));
+
+		msg << "filling skippable text with text symbols ... " << flush;
+
+		text_t T(n);
+
+		for(itype i=0;i<n;++i) T.set(i,symbol_to_int[S[i]]);
+
+		if(separator <= max_c) sep = symbol_to_int[separator];
+
+		S = seq_t();
+
+		msg << "done. " << endl << endl;
+
+		msg << "alphabet size is " << sigma  << " (" << k << " frequent symbols)" << endl << endl;
+
+		X = k;
+
+		replace_pairs(T, n, min_high_frequency, F);
+
+		if(stopped) return;
+
+		//canonical ids: terminals 0, ..., sigma-1, then rules in creation order
+		auto canonical = [&](itype s){
+
+			return 	s < k ? s :
+					s < rare_begin ? sigma + (s - k) :
+					s < rare_end ? k + (s - rare_begin) :
+					sigma + n_hf_rules + (s - rare_end);
+
+		};
+
+		for(auto & ab : G) ab = {canonical(ab.first),canonical(ab.second)};
+		for(auto & s : T_vec) s = canonical(s);
+
+		X = sigma + G.size();
+
+		//collapsed chains break the creation order of the rules expected by the archive encoder
+		if(collapse_chains) sort_rules(G, T_vec, sigma);
+
+	}
+
+	/*
+	 * Re-Pair on text T (of initial length n) whose symbols are < X. pair_freq, if not empty, contains the
+	 * frequencies of the pairs of frequent symbols (see text_positions)
+	 */
+	void replace_pairs(text_t & T, itype n, itype min_high_frequency, const vector<itype> & pair_freq = {}){
+
+		msg << "initializing and sorting text positions vector ... " << flush;
+
+		TP_t TP(&T,min_high_frequency,0,pair_freq);
+
+		msg << "done. Number of text positions containing a high-frequency pair: " << TP.size() << endl;
+
+		msg << "\nSTEP 1. HIGH FREQUENCY PAIRS" << endl << endl;
+
+		msg << "inserting pairs in high-frequency queue ... " << flush;
+
+		hf_q_t HFQ;
+		new_high_frequency_queue(HFQ, TP, T, min_high_frequency);
+
+		msg << "done. Number of distinct high-frequency pairs = " << HFQ.size() << endl;
+
+		msg << "Replacing high-frequency pairs ... " << endl;
+
+		int last_perc = -1;
+		uint64_t F = 0;//largest freq
+
+		while(HFQ.max() != HFQ.nullpair() and not stop()){
+
+			auto f = substitution_round<hf_q_t>(HFQ, TP, T);
+
+			if(last_perc == -1){
+
+				F = f;
+
+				last_perc = 0;
+
+			}else{
+
+				int perc = 100-(100*f)/F;
+
+				if(perc > last_perc+4){
+
+					last_perc = perc;
+					msg << perc << "%" << endl;
+
+					progress(0.5*perc/100);
+
+				}
+
+			}
+
+		}
+
+		if(stopped) return;
+
+		n_hf_rules = G.size();
+
+		//new symbols must not collide with terminals parked above the high-frequency range
+		X = std::max(X, rare_end);
+
+		msg << "done. " << endl;
+		if(collapse_chains) msg << "Rules created by collapsing chains = " << n_chain_rules << " (of " << G.size() << ")" << endl;
+		msg << "Peak queue size = " << HFQ.peak() << " (" << double(HFQ.peak())/double(n) << "n)" << endl;
+		msg << "Peak size of TP's pair hash = " << TP.peak_hash_bytes() << " Bytes (" << double(TP.peak_hash_bytes())/double(n) << "n)" << endl;
+
+		//the symbol range changes in the next phase: free the pair hash
+		TP.release_hash();
+
+		if(T.number_of_non_blank_characters() < 2){
+
+			//the text has been reduced to one symbol: there are no low-frequency pairs
+			store_compressed_text(T);
+			progress(1);
+			return;
+
+		}
+
+		msg << "\nSTEP 2. LOW FREQUENCY PAIRS" << endl << endl;
+
+		/*
+		 * the high-frequency phase left symbols up to X-1 in the text, usually too many for TP's direct-address
+		 * hash. Rename the symbols still in the text with dense ids 0, ..., D-1 (preserving their order, so the
+		 * grammar does not change) and number new symbols from D. Original ids are restored at the end.
+		 */
+		msg << "Densifying symbols ... " << flush;
+
+		itype X_hf = X; //next free symbol after the high-frequency phase
+		itype G_hf = G.size(); //number of high-frequency rules
+
+		vector<itype> dense_to_symbol = densify(T);
+		itype D = dense_to_symbol.size();
+
+		if(sep != ~itype(0)) sep = std::lower_bound(dense_to_symbol.begin(),dense_to_symbol.end(),sep) - dense_to_symbol.begin();
+
+		if(max_height > 0){
+
+			vector<itype> dense_height(D);
+			for(itype d=0;d<D;++d) dense_height[d] = height_of(dense_to_symbol[d]);
+
+			height.swap(dense_height);
+
+		}
+
+		X = D;
+
+		msg << "done. Symbols in the text: " << D << " (largest id was " << X_hf-1 << ")" << endl;
+
+		if(lf_threads > 1 and D <= (itype(1)<<16) and T.number_of_non_blank_characters() >= uint64_t(lf_threads)*MIN_SEGMENT){
+
+			replace_segments(T, min_high_frequency);
+
+			if(stopped) return;
+
+		}
+
+		if(T.number_of_non_blank_characters() > 1) low_frequency_phase(T, TP, n, min_high_frequency, lf_threads > 1 ? 0.75 : 0.5);
+
+		if(stopped) return;
+
+		store_compressed_text(T);
+
+		//restore original symbol ids in the low-frequency rules and in the compressed text
+		auto restore = [&](itype s){
+
+			return s < D ? dense_to_symbol[s] : X_hf + (s - D);
+
+		};
+
+		for(itype r = G_hf;r<G.size();++r) G[r] = {restore(G[r].first),restore(G[r].second)};
+		for(auto & s : T_vec) s = restore(s);
+
+		X = X_hf + (X - D);
+
+		vector<itype>().swap(height);
+
+		progress(1);
+
+	}
+
+	/*
+	 * STEP 2 on text T (dense symbols, new symbols from X): replace all pairs occurring at least twice.
+	 * All pairs must have frequency < min_high_frequency. Progress goes from p0 to 1
+	 */
+	void low_frequency_phase(text_t & T, TP_t & TP, itype n, itype min_high_frequency, double p0){
+
+		msg << "Re-computing TP array ... " << flush;
+
+		//T.compact(); //remove blank positions
+		TP.fill_with_text_positions(); //store here all remaining text positions
+
+		msg << "done." << endl;
+
+		msg << "Sorting  TP array ... " << flush;
+		TP.cluster(); //cluster text positions by character pairs
+		msg << "done." << endl;
+
+
+		msg << "Counting low-frequency pairs ... " << flush;
+		/*
+		 * scan sorted array of text positions and count frequencies
+		 *
+		 * in this phase, all pairs have frequency < min_high_frequency
+		 *
+		 * after counting, frequencies[f] is the number of pairs with frequency equal to f
+		 *
+		 */
+		//auto frequencies = vector<uint64_t>(min_high_frequency,0);
+		uint64_t n_lf_pairs = 0; //number of low-frequency pairs
+
+		uint64_t f = 1;
+		for(uint64_t i=1;i<TP.size();++i){
+
+			if(T.key_starting_at(TP[i]) == T.key_starting_at(TP[i-1])){
+
+				f++;
+
+			}else{
+
+				f=1;
+				n_lf_pairs++;
+
+			}
+
+		}
+		msg << "done. Number of distict low-frequency pairs: "<< n_lf_pairs << endl;
+
+		msg << "Filling low-frequency queue ... " << flush;
+
+		lf_q_t LFQ(min_high_frequency-1);
+
+		f = 1;
+
+		using el_t = typename lf_q_t::el_type;
+
+		for(uint64_t i=1;i<TP.size();++i){
+
+			if(T.key_starting_at(TP[i]) == T.key_starting_at(TP[i-1])){
+
+				f++;
+
+			}else{
+
+				cpair ab = unpack_pair<itype>(T.key_starting_at(TP[i-1]));
+
+				if(f>1 and pairable(ab)){
+
+					assert(i>=f);
+					itype P_ab = i - f;
+
+					itype L_ab = f;
+
+					itype F_ab = f;
+
+					el_t el = {ab,P_ab,L_ab,F_ab};
+
+					LFQ.insert(el);
+
+				}
+
+				f=1;
+
+			}
+
+		}
+
+		msg << "done." << endl;
+
+		msg << "Replacing low-frequency pairs ... " << endl;
+
+		pair<itype,itype> replaced = {0,0};
+
+		itype G0 = G.size();
+		itype chain0 = n_chain_rules;
+
+		int last_perc = -1;
+		uint64_t tl = T.number_of_non_blank_characters();
+
+		while(LFQ.max() != LFQ.nullpair() and not stop()){
+
+			auto f = substitution_round<lf_q_t>(LFQ, TP, T);
+
+			int perc = 100-(100*T.number_of_non_blank_characters())/tl;
+
+			if(perc>last_perc+4){
+
+				last_perc = perc;
+
+				msg << perc << "%" << endl;
+
+				progress(p0+(1-p0)*perc/100);
+
+			}
+
+		}
+
+		if(stopped) return;
+
+		msg << "done. " << endl;
+		if(collapse_chains) msg << "Rules created by collapsing chains = " << n_chain_rules-chain0 << " (of " << G.size()-G0 << ")" << endl;
+		msg << "Peak queue size = " << LFQ.peak() << " (" << double(LFQ.peak())/double(n) << "n)" << endl;
+		msg << "Peak size of TP's pair hash = " << TP.peak_hash_bytes() << " Bytes (" << double(TP.peak_hash_bytes())/double(n) << "n)" << endl;
+
+	}
+
+	/*
+	 * parallel part of STEP 2 (see lf_threads): T's non-blank characters are split into lf_threads segments
+	 * and each is compressed by its own (quiet) re_pair object, with new symbols numbered from X in every
+	 * segment. Equal rules of different segments are then merged, new global ids are assigned in segment
+	 * order (so the result does not depend on thread scheduling) and the replacements are applied to T
+	 */
+	void replace_segments(text_t & T, itype min_high_frequency){
+
+		itype G_begin = G.size();
+
+		vector<itype> pos; //non-blank positions of T
+
+		for(itype i=0;i<T.size();++i) if(not T.is_blank(i)) pos.push_back(i);
+
+		uint64_t n_seg = lf_threads;
+		uint64_t m = pos.size();
+
+		msg << "Replacing low-frequency pairs in " << n_seg << " segments, in parallel ... " << flush;
+
+		deque<re_pair> R;
+		for(uint64_t s=0;s<n_seg;++s) R.emplace_back(false);
+
+		auto worker = [&](uint64_t s){
+
+			itype b = (m*s)/n_seg;
+			itype e = (m*(s+1))/n_seg;
+
+			text_t Ts(e-b);
+
+			for(itype i=b;i<e;++i) Ts.set(i-b,T[pos[i]]);
+
+			R[s].X = X;
+			R[s].sep = sep;
+			R[s].cancel = cancel;
+			R[s].max_height = max_height;
+			R[s].sync_ratio = sync_ratio;
+			R[s].collapse_chains = collapse_chains;
+			R[s].height = height;
+
+			TP_t TPs(&Ts,min_high_frequency);
+
+			assert(TPs.size() == 0);
+
+			R[s].low_frequency_phase(Ts, TPs, e-b, min_high_frequency, 0.5);
+			R[s].store_compressed_text(Ts);
+
+		};
+
+		{
+			vector<std::thread> threads;
+			for(uint64_t s=0;s<n_seg;++s) threads.push_back(std::thread(worker,s));
+			for(auto & t : threads) t.join();
+		}
+
+		for(auto & r : R) stopped = stopped or r.stopped;
+
+		if(stop()) return;
+
+		msg << "done." << endl;
+
+		msg << "Merging the rules of the segments ... " << flush;
+
+		//global id of every rule (a,b) created so far, a and b global ids
+		unordered_map<pair_key_t,itype,pair_key_hash> rule_id;
+
+		itype local_rules = 0;
+
+		for(uint64_t s=0;s<n_seg;++s){
+
+			itype b = (m*s)/n_seg;
+
+			local_rules += R[s].G.size();
+
+			//global id and expansion length (in characters of T) of every local symbol >= X
+			vector<itype> id(R[s].G.size());
+			vector<itype> len(R[s].G.size());
+
+			auto global = [&](itype x){ return x < X ? x : id[x-X]; };
+			auto length = [&](itype x){ return x < X ? 1 : len[x-X]; };
+
+			for(itype r=0;r<R[s].G.size();++r){
+
+				auto ab = R[s].G[r];
+				cpair g_ab = {global(ab.first),global(ab.second)};
+
+				pair_key_t k = pack_pair(g_ab.first,g_ab.second);
+
+				auto it = rule_id.find(k);
+
+				if(it == rule_id.end()){
+
+					it = rule_id.insert({k,X + itype(G.size() - G_begin)}).first;
+					G.push_back(g_ab);
+
+					if(max_height > 0) set_height(it->second,g_ab);
+
+				}
+
+				id[r] = it->second;
+				len[r] = length(ab.first) + length(ab.second);
+
+			}
+
+			R[s].G = {};
+
+			//replace the expansion of every symbol of the segment's compressed text with its global id
+			for(auto x : R[s].T_vec){
+
+				for(itype j=1;j<length(x);++j) T.replace(pos[b],global(x));
+
+				b += length(x);
+
+			}
+
+			R[s].T_vec = {};
+
+		}
+
+		X += G.size() - G_begin;
+
+		msg << "done. " << local_rules << " rules, " << G.size() - G_begin << " after merging. Symbols left in the text: " << T.number_of_non_blank_characters() << endl;
+
+		progress(0.75);
+
+		msg << "\nFinal sequential pass" << endl << endl;
+
+	}
+
+	/*
+	 * rename the symbols in T with dense ids preserving their order. Return the
+	 * original id of each dense id
+	 */
+	vector<itype> densify(text_t & T){
+
+		const itype null = ~itype(0);
+
+		vector<bool> present(X,false);
+
+		for(itype i=0;i<T.size();++i){
+
+			if(not T.is_blank(i)) present[T[i]] = true;
+
+		}
+
+		vector<itype> new_symbol(X,null);
+		vector<itype> dense_to_symbol;
+
+		for(itype s=0;s<X;++s){
+
+			if(present[s]){
+
+				new_symbol[s] = dense_to_symbol.size();
+				dense_to_symbol.push_back(s);
+
+			}
+
+		}
+
+		T.remap(new_symbol);
+
+		return dense_to_symbol;
+
+	}
+
+	/*
+	 * copy non-blank characters of T to T_vec
+	 */
+	void store_compressed_text(text_t & T){
+
+		for(itype i=0;i<T.size();++i){
+
+			if(not T.is_blank(i)) T_vec.push_back(T[i]);
+
+		}
+
+	}
+
+	//next free dictionary symbol
+	itype X=0;
+	itype last_freq = 0;
+	itype n_distinct_freqs = 0;
+
+	bool stopped = false; //true iff compression was cancelled
+
+	itype n_hf_rules = 0;
+	itype sep = ~itype(0); //id of the separator in T
+	itype rare_end = 0; //terminals may use ids up to rare_end-1 (see compute_repair(S))
+
+	vector<itype> height; //height of the rule symbols of the text (if max_height > 0)
+
+	itype n_chain_rules = 0; //rules created by collapse_chain
+
+	//segments of the parallel low-frequency phase are at least this long
+	static const itype MIN_SEGMENT = itype(1)<<16;
+
+	//progress messages
+	ostream msg;
+
+};
+
+typedef re_pair<uint32_t> re_pair32_t;
+typedef re_pair<uint64_t> re_pair64_t;
+
+#endif /* INTERNAL_RE_PAIR_HPP_ */
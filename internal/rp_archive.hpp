@@ -0,0 +1,154 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * rp_archive.hpp
+ *
+ *  Created on: Mar 2, 2017
+ *      Author: nico
+ *
+ *  an rp archive: alphabet A, grammar G, compressed text T and a set of optional
+ *  tagged sections. Sections are stored after T as a sequence of
+ *
+ *  	<tag, size, payload[0], ..., payload[size-1]>
+ *
+ *  so that archives written without sections are still readable (and vice versa:
+ *  decoders that do not know a tag can skip it).
+ *
+ */
+
+#ifndef INTERNAL_RP_ARCHIVE_HPP_
+#define INTERNAL_RP_ARCHIVE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packed_gamma_file3.hpp"
+
+using namespace std;
+
+/*
+ * section tags
+ */
+enum rp_section{
+
+	RP_SECTION_END = 0,
+	RP_SECTION_CRC32C = 1, //<crc32c of the expanded text, expanded text length>
+	RP_SECTION_COLUMNS = 2, //record layout of a text split into columns (see column_layout.hpp)
+	RP_SECTION_TOKENS = 3, //token dictionary of a word-token archive (see word_tokenizer.hpp)
+	RP_SECTION_FASTA = 4, //headers, line lengths, soft-masking and non-ACGT runs of a DNA archive (see fasta_layout.hpp)
+	RP_SECTION_POSTINGS = 5, //symbol values and number of lists of a posting-list archive (see posting_lists.hpp)
+	RP_SECTION_FILE_CRC32C = 6, //<crc32c, length> of the input file, if the expanded text is not the file (FASTA archives)
+
+};
+
+template<typename itype = uint32_t>
+class rp_archive{
+
+public:
+
+	rp_archive(){}
+
+	/*
+	 * load archive from file
+	 */
+	rp_archive(string filename){
+
+		load(filename);
+
+	}
+
+	void load(string filename){
+
+		packed_gamma_file3<itype> pgf(filename, false);
+
+		vector<itype> raw;
+		pgf.read_and_decompress(A,G,T,raw);
+
+		sections = {};
+
+		uint64_t i = 0;
+
+		while(i < raw.size()){
+
+			itype tag = raw[i++];
+
+			if(tag == RP_SECTION_END || i >= raw.size()) break;
+
+			uint64_t size = raw[i++];
+
+			assert(i+size <= raw.size());
+
+			sections[tag] = vector<itype>(raw.begin()+i, raw.begin()+i+size);
+			i += size;
+
+		}
+
+	}
+
+	/*
+	 * compress the archive and store it to file. If verbose, print statistics
+	 */
+	void store(string filename, bool verbose = true){
+
+		vector<itype> raw;
+
+		for(auto & s : sections){
+
+			raw.push_back(s.first);
+			raw.push_back(s.second.size());
+			raw.insert(raw.end(),s.second.begin(),s.second.end());
+
+		}
+
+		packed_gamma_file3<itype> out_file(filename);
+		out_file.per_stream = per_stream;
+		out_file.compress_and_store(A,G,T,raw,verbose);
+
+	}
+
+	bool has_section(itype tag){
+
+		return sections.count(tag) == 1;
+
+	}
+
+	vector<itype> & section(itype tag){
+
+		assert(has_section(tag));
+		return sections[tag];
+
+	}
+
+	void set_section(itype tag, const vector<itype> & payload){
+
+		assert(tag != RP_SECTION_END);
+		sections[tag] = payload;
+
+	}
+
+	vector<itype> A; //alphabet (mapping int->ascii)
+	vector<pair<itype, itype> > G; //grammar
+	vector<itype> T; //compressed text
+
+	bool per_stream = false; //if true, store may use the multi-stream layout (see packed_gamma_file3.hpp)
+
+private:
+
+	map<itype, vector<itype> > sections;
+
+};
+
+#endif /* INTERNAL_RP_ARCHIVE_HPP_ */
@@ -0,0 +1,534 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * rp_async.hpp
+ *
+ *  Created on: Mar 9, 2017
+ *      Author: nico
+ *
+ *  asynchronous compression/decompression of files, for use as a library inside a service.
+ *
+ *  Jobs run on an executor supplied by the caller (any callable taking a function<void()>) or on
+ *  an internal thread pool. compress_async/decompress_async return immediately with a handle that
+ *  exposes a future, the progress (in [0,1]) and cancellation; an optional callback is invoked
+ *  with the final status on the thread that ran the job.
+ *
+ *  Re-Pair needs about 6n Bytes of RAM for a text of n characters, so running one job per core
+ *  can exhaust memory. Jobs are started in submission order as long as the sum of their estimated
+ *  memory stays within the budget (a job larger than the whole budget runs alone).
+ *
+ */
+
+#ifndef INTERNAL_RP_ASYNC_HPP_
+#define INTERNAL_RP_ASYNC_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "re_pair.hpp"
+#include "rp_archive.hpp"
+#include "grammar.hpp"
+#include "column_layout.hpp"
+#include "fasta_layout.hpp"
+#include "posting_lists.hpp"
+
+using namespace std;
+
+enum rp_job_status{
+
+	RP_JOB_QUEUED = 0,
+	RP_JOB_RUNNING = 1,
+	RP_JOB_DONE = 2,
+	RP_JOB_FAILED = 3, //unreadable input or corrupted archive
+	RP_JOB_CANCELLED = 4,
+
+};
+
+/*
+ * fixed-size pool of worker threads executing tasks in FIFO order
+ */
+class thread_pool{
+
+public:
+
+	thread_pool(unsigned n_threads){
+
+		n_threads = n_threads == 0 ? 1 : n_threads;
+
+		for(unsigned i=0;i<n_threads;++i) workers.push_back(thread([this]{ work(); }));
+
+	}
+
+	/*
+	 * run the tasks still in the queue, then join the workers
+	 */
+	~thread_pool(){
+
+		{
+			lock_guard<mutex> lock(m);
+			closing = true;
+		}
+
+		cv.notify_all();
+
+		for(auto & w : workers) w.join();
+
+	}
+
+	void submit(function<void()> task){
+
+		{
+			lock_guard<mutex> lock(m);
+			tasks.push_back(task);
+		}
+
+		cv.notify_one();
+
+	}
+
+private:
+
+	void work(){
+
+		while(true){
+
+			function<void()> task;
+
+			{
+				unique_lock<mutex> lock(m);
+				cv.wait(lock, [this]{ return closing or not tasks.empty(); });
+
+				if(tasks.empty()) return;
+
+				task = tasks.front();
+				tasks.pop_front();
+			}
+
+			task();
+
+		}
+
+	}
+
+	vector<thread> workers;
+	deque<function<void()> > tasks;
+
+	mutex m;
+	condition_variable cv;
+	bool closing = false;
+
+};
+
+template<typename itype = uint32_t>
+class rp_async{
+
+	struct job_state;
+
+public:
+
+	using executor_t = function<void(function<void()>)>;
+	using callback_t = function<void(rp_job_status)>;
+
+	/*
+	 * handle of a submitted job. Copies refer to the same job
+	 */
+	class job{
+
+	public:
+
+		job(){}
+
+		/*
+		 * request cancellation. A queued job does not start; a running one stops at the next
+		 * substitution round (compression) or block of output (decompression)
+		 */
+		void cancel(){
+			st->cancel = true;
+		}
+
+		/*
+		 * fraction of the work done, in [0,1]
+		 */
+		double progress(){
+			return st->progress;
+		}
+
+		rp_job_status status(){
+			return rp_job_status(st->status.load());
+		}
+
+		/*
+		 * ready when the job has finished, with its final status
+		 */
+		shared_future<rp_job_status> future(){
+			return st->result;
+		}
+
+		rp_job_status wait(){
+			return st->result.get();
+		}
+
+	private:
+
+		friend class rp_async;
+
+		job(shared_ptr<job_state> st) : st(st) {}
+
+		shared_ptr<job_state> st;
+
+	};
+
+	/*
+	 * run jobs on an internal pool of n_threads threads. Jobs in flight use at most
+	 * (about) memory_budget Bytes of RAM
+	 */
+	rp_async(uint64_t memory_budget, unsigned n_threads = thread::hardware_concurrency()){
+
+		this->memory_budget = memory_budget;
+
+		pool = unique_ptr<thread_pool>(new thread_pool(n_threads));
+
+		thread_pool * p = pool.get();
+		executor = [p](function<void()> task){ p->submit(task); };
+
+	}
+
+	/*
+	 * run jobs on the caller's executor
+	 */
+	rp_async(uint64_t memory_budget, executor_t executor){
+
+		this->memory_budget = memory_budget;
+		this->executor = executor;
+
+	}
+
+	/*
+	 * wait for all submitted jobs to finish
+	 */
+	~rp_async(){
+
+		unique_lock<mutex> lock(m);
+		idle.wait(lock, [this]{ return in_flight_jobs == 0 and pending.empty(); });
+
+	}
+
+	/*
+	 * compress file in and store the archive to file out
+	 */
+	job compress_async(string in, string out, callback_t callback = nullptr){
+
+		uint64_t n = 0;
+
+		{
+			ifstream file(in,ios::ate);
+			if(file.good()) n = file.tellg();
+		}
+
+		auto run = [in, out](job_state & st) -> rp_job_status {
+
+			if(not ifstream(in).good()) return RP_JOB_FAILED;
+
+			re_pair<itype> RP(false);
+
+			RP.cancel = &st.cancel;
+			RP.on_progress = [&st](double p){ st.progress = p; };
+
+			RP.compress(in);
+
+			if(RP.cancelled()) return RP_JOB_CANCELLED;
+
+			rp_archive<itype> arc;
+			arc.A.swap(RP.A);
+			arc.G.swap(RP.G);
+			arc.T.swap(RP.T_vec);
+			arc.set_section(RP_SECTION_CRC32C, {RP.text_crc, RP.text_length});
+
+			arc.store(out,false);
+
+			return RP_JOB_DONE;
+
+		};
+
+		return submit(run, 6*n, callback);
+
+	}
+
+	/*
+	 * decompress archive in and store the text to file out. The checksum (if any) is
+	 * verified before expanding: the job fails if it does not match
+	 */
+	job decompress_async(string in, string out, callback_t callback = nullptr){
+
+		uint64_t size = 0;
+
+		{
+			ifstream file(in,ios::ate);
+			if(file.good()) size = file.tellg();
+		}
+
+		auto run = [in, out](job_state & st) -> rp_job_status {
+
+			if(not ifstream(in).good()) return RP_JOB_FAILED;
+
+			rp_archive<itype> arc(in);
+
+			if(arc.has_section(RP_SECTION_POSTINGS)){
+
+				posting_lists<itype> P(arc);
+
+				if(arc.has_section(RP_SECTION_CRC32C)){
+
+					auto & s = arc.section(RP_SECTION_CRC32C);
+					auto c = P.crc32c();
+
+					if(s.size() < 2 or s[0] != c.first or s[1] != c.second) return RP_JOB_FAILED;
+
+				}
+
+				if(st.cancel) return RP_JOB_CANCELLED;
+
+				ofstream ofs(out);
+				P.expand(ofs);
+
+				return RP_JOB_DONE;
+
+			}
+
+			grammar<itype> G(arc);
+
+			if(arc.has_section(RP_SECTION_CRC32C)){
+
+				auto & s = arc.section(RP_SECTION_CRC32C);
+
+				if(s.size() < 2 or s[0] != G.crc32c() or s[1] != G.text_length()) return RP_JOB_FAILED;
+
+			}
+
+			//FASTA archives also store the checksum of the whole file
+			if(arc.has_section(RP_SECTION_FASTA) and arc.has_section(RP_SECTION_FILE_CRC32C)){
+
+				auto & s = arc.section(RP_SECTION_FILE_CRC32C);
+				auto c = fasta_layout<itype>(arc.section(RP_SECTION_FASTA)).crc32c(G);
+
+				if(s.size() < 2 or s[0] != c.first or s[1] != c.second) return RP_JOB_FAILED;
+
+			}
+
+			ofstream ofs(out);
+
+			if(arc.has_section(RP_SECTION_COLUMNS)){
+
+				if(st.cancel) return RP_JOB_CANCELLED;
+
+				column_layout<itype> L(arc.section(RP_SECTION_COLUMNS));
+				L.expand(G,ofs);
+
+				return RP_JOB_DONE;
+
+			}
+
+			if(arc.has_section(RP_SECTION_FASTA)){
+
+				if(st.cancel) return RP_JOB_CANCELLED;
+
+				fasta_layout<itype> L(arc.section(RP_SECTION_FASTA));
+				L.expand(G,ofs);
+
+				return RP_JOB_DONE;
+
+			}
+
+			uint64_t t = G.text().size();
+			uint64_t block = 1<<16; //compressed text symbols expanded between two cancellation checks
+
+			for(uint64_t b = 0;b<t;b+=block){
+
+				if(st.cancel){
+
+					ofs.close();
+					std::remove(out.c_str());
+
+					return RP_JOB_CANCELLED;
+
+				}
+
+				G.expand(ofs,b,std::min(b+block,t));
+
+				st.progress = double(std::min(b+block,t))/t;
+
+			}
+
+			return RP_JOB_DONE;
+
+		};
+
+		//the in-memory grammar takes roughly 8 Bytes per archive Byte
+		return submit(run, 8*size, callback);
+
+	}
+
+private:
+
+	struct job_state{
+
+		atomic<bool> cancel{false};
+		atomic<double> progress{0};
+		atomic<int> status{RP_JOB_QUEUED};
+
+		promise<rp_job_status> done;
+		shared_future<rp_job_status> result;
+
+		function<rp_job_status(job_state &)> run;
+		callback_t callback;
+
+		uint64_t bytes = 0; //estimated memory
+
+	};
+
+	job submit(function<rp_job_status(job_state &)> run, uint64_t bytes, callback_t callback){
+
+		auto st = make_shared<job_state>();
+
+		st->result = st->done.get_future().share();
+		st->run = run;
+		st->callback = callback;
+		st->bytes = bytes;
+
+		vector<shared_ptr<job_state> > ready;
+
+		{
+			lock_guard<mutex> lock(m);
+
+			pending.push_back(st);
+			ready = next_jobs();
+		}
+
+		start(ready);
+
+		return job(st);
+
+	}
+
+	/*
+	 * pop from the queue the jobs that fit in the memory budget (cancelled jobs always pass,
+	 * they finish immediately). Called with the lock held
+	 */
+	vector<shared_ptr<job_state> > next_jobs(){
+
+		vector<shared_ptr<job_state> > ready;
+
+		while(not pending.empty()){
+
+			auto st = pending.front();
+
+			bool fits = in_flight_jobs == 0 or in_flight_bytes + st->bytes <= memory_budget;
+
+			if(not fits and not st->cancel) break;
+
+			pending.pop_front();
+
+			in_flight_jobs++;
+			in_flight_bytes += st->bytes;
+
+			ready.push_back(st);
+
+		}
+
+		return ready;
+
+	}
+
+	void start(vector<shared_ptr<job_state> > & ready){
+
+		for(auto st : ready) executor([this, st]{ execute(st); });
+
+	}
+
+	void execute(shared_ptr<job_state> st){
+
+		rp_job_status s = RP_JOB_CANCELLED;
+
+		if(not st->cancel){
+
+			st->status = RP_JOB_RUNNING;
+
+			try{
+
+				s = st->run(*st);
+
+			}catch(...){
+
+				s = RP_JOB_FAILED;
+
+			}
+
+		}
+
+		if(s == RP_JOB_DONE) st->progress = 1;
+
+		st->status = s;
+		st->done.set_value(s);
+
+		if(st->callback) st->callback(s);
+
+		vector<shared_ptr<job_state> > ready;
+
+		{
+			lock_guard<mutex> lock(m);
+
+			in_flight_jobs--;
+			in_flight_bytes -= st->bytes;
+
+			ready = next_jobs();
+
+			//after the lock is released, this object may be destroyed unless other jobs are in flight
+			if(in_flight_jobs == 0 and pending.empty()) idle.notify_all();
+		}
+
+		start(ready);
+
+	}
+
+	uint64_t memory_budget = 0;
+
+	executor_t executor;
+
+	deque<shared_ptr<job_state> > pending;
+	uint64_t in_flight_jobs = 0;
+	uint64_t in_flight_bytes = 0;
+
+	mutex m;
+	condition_variable idle;
+
+	//declared last: destroyed (and joined) first
+	unique_ptr<thread_pool> pool;
+
+};
+
+typedef rp_async<uint32_t> rp_async32_t;
+typedef rp_async<uint64_t> rp_async64_t;
+
+#endif /* INTERNAL_RP_ASYNC_HPP_ */
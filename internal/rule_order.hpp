@@ -0,0 +1,121 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * rule_order.hpp
+ *
+ *  Created on: Mar 24, 2017
+ *      Author: nico
+ *
+ *  order of the rules of a grammar before it is stored (see packed_gamma_file3)
+ *
+ */
+
+#ifndef INTERNAL_RULE_ORDER_HPP_
+#define INTERNAL_RULE_ORDER_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/*
+ * renumber the rules G (symbols sigma, sigma+1, ...; the children of a rule are smaller than the rule) of
+ * the compressed text T in the order in which they become expandable: first the rules on two terminals by
+ * increasing max(a,b), then every rule right after the later of its children. The larger children max(a,b)
+ * then form a single non-decreasing sequence, which the archive encoder stores as small deltas (see
+ * packed_gamma_file3).
+ *
+ * In Re-Pair's creation order they are mostly non-decreasing already, and that order gives small ids to
+ * frequent rules (better for the compressed text): rules are renumbered only if the sequence breaks more
+ * than g/16 times, e.g. after re_pair::collapse_chain created many rules, or for grammars built in another
+ * order (sequitur.hpp)
+ */
+template<typename itype>
+void sort_rules(vector<pair<itype, itype> > & G, vector<itype> & T, itype sigma){
+
+	itype g = G.size();
+
+	itype breaks = 0;
+
+	for(itype r=1;r<g;++r) breaks += std::max(G[r].first,G[r].second) < std::max(G[r-1].first,G[r-1].second);
+
+	if(breaks <= g/16) return;
+
+	//parents of rule r: parent[parent_begin[r] ... parent_begin[r+1]-1] (once per child occurrence)
+	vector<itype> parent_begin(uint64_t(g)+1,0);
+	vector<uint8_t> missing(g,0); //children not yet renumbered
+
+	for(itype r=0;r<g;++r){
+
+		assert(G[r].first < sigma+r and G[r].second < sigma+r);
+
+		if(G[r].first >= sigma){ parent_begin[G[r].first-sigma+1]++; missing[r]++; }
+		if(G[r].second >= sigma){ parent_begin[G[r].second-sigma+1]++; missing[r]++; }
+
+	}
+
+	for(itype r=0;r<g;++r) parent_begin[r+1] += parent_begin[r];
+
+	vector<itype> parent(parent_begin[g]);
+	vector<itype> next(parent_begin.begin(),parent_begin.end()-1);
+
+	for(itype r=0;r<g;++r){
+
+		if(G[r].first >= sigma) parent[next[G[r].first-sigma]++] = r;
+		if(G[r].second >= sigma) parent[next[G[r].second-sigma]++] = r;
+
+	}
+
+	next = {};
+
+	vector<itype> order;
+	order.reserve(g);
+
+	for(itype r=0;r<g;++r) if(missing[r] == 0) order.push_back(r);
+
+	std::stable_sort(order.begin(),order.end(),[&](itype r1, itype r2){
+
+		return std::max(G[r1].first,G[r1].second) < std::max(G[r2].first,G[r2].second);
+
+	});
+
+	vector<itype> id(g); //new index of each rule
+
+	for(uint64_t j=0;j<order.size();++j){
+
+		itype r = order[j];
+		id[r] = j;
+
+		for(itype k=parent_begin[r];k<parent_begin[r+1];++k) if(--missing[parent[k]] == 0) order.push_back(parent[k]);
+
+	}
+
+	assert(order.size() == g);
+
+	auto new_symbol = [&](itype s){ return s < sigma ? s : sigma + id[s-sigma]; };
+
+	vector<pair<itype, itype> > G1(g);
+
+	for(itype j=0;j<g;++j) G1[j] = {new_symbol(G[order[j]].first),new_symbol(G[order[j]].second)};
+
+	G.swap(G1);
+
+	for(auto & s : T) s = new_symbol(s);
+
+}
+
+#endif /* INTERNAL_RULE_ORDER_HPP_ */
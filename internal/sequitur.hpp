@@ -0,0 +1,560 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * sequitur.hpp
+ *
+ *  Created on: Mar 24, 2017
+ *      Author: nico
+ *
+ *  online grammar compressor (Sequitur, Nevill-Manning and Witten 1997): characters are appended one at a
+ *  time and the grammar is kept such that
+ *
+ *  - no pair of adjacent symbols (digram) appears more than once (digram uniqueness);
+ *  - every rule is used more than once (rule utility).
+ *
+ *  The text is never stored: the engine holds only the grammar (its rules are doubly-linked lists of
+ *  symbols) and a hash table of its digrams. To bound memory, when the grammar holds more than max_symbols
+ *  symbols it is frozen: its rules are appended to the output and the engine restarts with an empty
+ *  grammar (later repeats of frozen content are not shared with it). The working memory is then about
+ *  60 Bytes per symbol of the bound, whatever the length of the stream.
+ *
+ *  The output <A, G, T_vec> has the format of re_pair.hpp: rules of any length are split into binary rules
+ *  (a balanced tree per rule), the bodies of the top-level rules of all blocks form T_vec. It can be stored
+ *  with rp_archive and read by all query tools.
+ *
+ *  Complexity: O(1) amortized (expected) time per character.
+ *
+ */
+
+#ifndef INTERNAL_SEQUITUR_HPP_
+#define INTERNAL_SEQUITUR_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32c.hpp"
+#include "pair_key.hpp"
+#include "rule_order.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class sequitur{
+
+public:
+
+	/*
+	 * the working grammar is frozen whenever it holds more than max_symbols symbols
+	 */
+	sequitur(uint64_t max_symbols = uint64_t(1)<<22){
+
+		assert(max_symbols > 0);
+
+		this->max_symbols = max_symbols;
+
+		reset();
+
+	}
+
+	/*
+	 * append character c to the text
+	 */
+	void push_back(uint8_t c){
+
+		assert(not finished);
+
+		text_crc = crc32c::update(text_crc,c);
+		text_length++;
+
+		itype s = new_symbol(c);
+
+		insert_after(last(0),s);
+		check(prev(s));
+
+		if(n_symbols > max_symbols) freeze();
+
+	}
+
+	/*
+	 * append the characters read from stream in, then finish()
+	 */
+	void compress(istream & in){
+
+		for(istreambuf_iterator<char> it(in), end; it != end; ++it) push_back(uint8_t(*it));
+
+		finish();
+
+	}
+
+	/*
+	 * compute <A, G, T_vec>. No character can be appended afterwards
+	 */
+	void finish(){
+
+		assert(not finished);
+
+		freeze();
+
+		//terminals 0, ..., sigma-1 (in increasing byte order), then rules
+		vector<itype> terminal(256,0);
+
+		for(uint64_t c=0;c<256;++c){
+
+			if(present[c]){
+
+				terminal[c] = A.size();
+				A.push_back(c);
+
+			}
+
+		}
+
+		itype sigma = A.size();
+
+		auto final_symbol = [&](itype s){ return s < 256 ? terminal[s] : sigma + (s - 256); };
+
+		for(auto & ab : G) ab = {final_symbol(ab.first),final_symbol(ab.second)};
+		for(auto & s : T_vec) s = final_symbol(s);
+
+		//the rules were created children first, not in the order the archive encoder prefers
+		sort_rules(G, T_vec, sigma);
+
+		finished = true;
+
+	}
+
+	/*
+	 * number of times the working grammar was frozen (including the last block, after finish())
+	 */
+	uint64_t number_of_blocks(){
+		return blocks;
+	}
+
+	vector<itype> A; //alphabet (mapping int->ascii)
+	vector<pair<itype, itype> > G; //grammar
+	vector<itype> T_vec;// compressed text
+
+	uint32_t text_crc = 0; //CRC32C of the input text
+	uint64_t text_length = 0;
+
+private:
+
+	/*
+	 * a symbol of a rule's body: a character (value < 256) or a rule (value 256 + rule). Every rule's
+	 * body is a circular list closed by a guard node (value GUARD | rule)
+	 */
+	struct node{
+
+		itype prev;
+		itype next;
+		itype value;
+
+	};
+
+	static const itype NIL = ~itype(0);
+	static const itype GUARD = itype(1) << (8*sizeof(itype)-1);
+
+	itype prev(itype x){
+		return nodes[x].prev;
+	}
+
+	itype next(itype x){
+		return nodes[x].next;
+	}
+
+	itype value(itype x){
+		return nodes[x].value;
+	}
+
+	bool is_guard(itype x){
+		return (value(x) & GUARD) != 0;
+	}
+
+	bool is_rule_symbol(itype x){
+		return not is_guard(x) and value(x) >= 256;
+	}
+
+	/*
+	 * rule of a guard or of a rule symbol
+	 */
+	itype rule_of(itype x){
+		return is_guard(x) ? value(x) & ~GUARD : value(x) - 256;
+	}
+
+	itype first(itype r){
+		return next(guard[r]);
+	}
+
+	itype last(itype r){
+		return prev(guard[r]);
+	}
+
+	pair_key_t key(itype x){
+		return pack_pair(value(x),value(next(x)));
+	}
+
+	itype new_node(itype v){
+
+		itype x;
+
+		if(free_nodes.empty()){
+
+			x = nodes.size();
+			nodes.push_back({NIL,NIL,v});
+
+		}else{
+
+			x = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[x] = {NIL,NIL,v};
+
+		}
+
+		return x;
+
+	}
+
+	itype new_symbol(itype v){
+
+		if(v >= 256) uses[v-256]++;
+
+		n_symbols++;
+
+		return new_node(v);
+
+	}
+
+	itype new_rule(){
+
+		itype r;
+
+		if(free_rules.empty()){
+
+			r = guard.size();
+			guard.push_back(NIL);
+			uses.push_back(0);
+
+		}else{
+
+			r = free_rules.back();
+			free_rules.pop_back();
+
+		}
+
+		uses[r] = 0;
+		guard[r] = new_node(GUARD | r);
+
+		nodes[guard[r]].prev = guard[r];
+		nodes[guard[r]].next = guard[r];
+
+		return r;
+
+	}
+
+	/*
+	 * remove the entry of digram <x, next(x)> if it points to x
+	 */
+	void delete_digram(itype x){
+
+		if(is_guard(x) or is_guard(next(x))) return;
+
+		auto it = digrams.find(key(x));
+
+		if(it != digrams.end() and it->second == x) digrams.erase(it);
+
+	}
+
+	/*
+	 * link left -> right
+	 */
+	void join(itype left, itype right){
+
+		if(next(left) != NIL){
+
+			delete_digram(left);
+
+			//in a run aaa only the second digram is recorded: when it disappears, record the first one
+			if(	prev(right) != NIL and next(right) != NIL and
+				value(right) == value(prev(right)) and value(right) == value(next(right))) digrams[key(right)] = right;
+
+			if(	prev(left) != NIL and next(left) != NIL and
+				value(left) == value(next(left)) and value(left) == value(prev(left))) digrams[key(prev(left))] = prev(left);
+
+		}
+
+		nodes[left].next = right;
+		nodes[right].prev = left;
+
+	}
+
+	void insert_after(itype x, itype y){
+
+		join(y,next(x));
+		join(x,y);
+
+	}
+
+	/*
+	 * unlink and free non-guard node x
+	 */
+	void delete_symbol(itype x){
+
+		assert(not is_guard(x));
+
+		join(prev(x),next(x));
+		delete_digram(x);
+
+		if(is_rule_symbol(x)) uses[rule_of(x)]--;
+
+		n_symbols--;
+		free_nodes.push_back(x);
+
+	}
+
+	/*
+	 * enforce digram uniqueness on <x, next(x)>. Return true iff the digram was already in the grammar
+	 */
+	bool check(itype x){
+
+		if(is_guard(x) or is_guard(next(x))) return false;
+
+		auto it = digrams.find(key(x));
+
+		if(it == digrams.end()){
+
+			digrams[key(x)] = x;
+			return false;
+
+		}
+
+		itype m = it->second;
+
+		//overlapping occurrences (aaa) are left alone
+		if(next(m) != x) match(x,m);
+
+		return true;
+
+	}
+
+	/*
+	 * replace digram <x, next(x)> with rule r
+	 */
+	void substitute(itype x, itype r){
+
+		itype q = prev(x);
+
+		delete_symbol(next(q));
+		delete_symbol(next(q));
+
+		insert_after(q,new_symbol(256 + r));
+
+		if(not check(q)) check(next(q));
+
+	}
+
+	/*
+	 * digram <s, next(s)> has just appeared and equals digram <m, next(m)>
+	 */
+	void match(itype s, itype m){
+
+		itype r;
+
+		if(is_guard(prev(m)) and is_guard(next(next(m)))){
+
+			//m is the whole body of a rule: reuse it
+			r = rule_of(prev(m));
+			substitute(s,r);
+
+		}else{
+
+			r = new_rule();
+
+			insert_after(last(r),new_symbol(value(s)));
+			insert_after(last(r),new_symbol(value(next(s))));
+
+			substitute(m,r);
+			substitute(s,r);
+
+			digrams[key(first(r))] = first(r);
+
+		}
+
+		//rule utility: the first symbol of r may now be a rule used only here
+		if(is_rule_symbol(first(r)) and uses[rule_of(first(r))] == 1) expand(first(r));
+
+	}
+
+	/*
+	 * replace rule symbol x (whose rule is used only here) with the body of its rule, and delete the rule
+	 */
+	void expand(itype x){
+
+		itype left = prev(x);
+		itype right = next(x);
+
+		itype r = rule_of(x);
+		itype f = first(r);
+		itype l = last(r);
+
+		//delete the rule: its guard leaves the body
+		join(l,f);
+		free_nodes.push_back(guard[r]);
+		guard[r] = NIL;
+		free_rules.push_back(r);
+
+		auto it = digrams.find(key(x));
+		if(it != digrams.end() and it->second == x) digrams.erase(it);
+
+		//delete x (its rule is gone: no use to remove)
+		join(left,right);
+		n_symbols--;
+		free_nodes.push_back(x);
+
+		join(left,f);
+		join(l,right);
+
+		digrams[key(l)] = l;
+
+	}
+
+	/*
+	 * append the working grammar to <G, T_vec> (rules in the output numbering: character c is c, rule k of
+	 * G is 256 + k) and restart with an empty grammar
+	 */
+	void freeze(){
+
+		if(n_symbols == 0) return;
+
+		blocks++;
+
+		const itype none = NIL;
+		vector<itype> id(guard.size(),none); //output symbol of each rule
+
+		auto out = [&](itype x){
+
+			if(is_rule_symbol(x)) return id[rule_of(x)];
+
+			present[value(x)] = true;
+			return value(x);
+
+		};
+
+		//split the body of rule r (all its rule symbols have an id) into binary rules
+		auto emit = [&](itype r){
+
+			vector<itype> level;
+
+			for(itype x=first(r);x!=guard[r];x=next(x)) level.push_back(out(x));
+
+			assert(level.size() >= 2);
+
+			while(level.size() > 1){
+
+				vector<itype> level1;
+
+				for(uint64_t t=0;t+1<level.size();t+=2){
+
+					G.push_back({level[t],level[t+1]});
+					level1.push_back(256 + G.size() - 1);
+
+				}
+
+				if(level.size() % 2 == 1) level1.push_back(level.back());
+
+				level.swap(level1);
+
+			}
+
+			id[r] = level[0];
+
+		};
+
+		//rules reachable from the top-level rule 0, children first. <rule, next symbol to visit>
+		vector<pair<itype,itype> > stack = {{0,first(0)}};
+
+		while(not stack.empty()){
+
+			itype r = stack.back().first;
+			itype & x = stack.back().second;
+
+			while(x != guard[r] and not (is_rule_symbol(x) and id[rule_of(x)] == none)) x = next(x);
+
+			if(x == guard[r]){
+
+				stack.pop_back();
+
+				if(r != 0) emit(r);
+
+			}else{
+
+				itype c = rule_of(x);
+				stack.push_back({c,first(c)});
+
+			}
+
+		}
+
+		for(itype x=first(0);x!=guard[0];x=next(x)) T_vec.push_back(out(x));
+
+		reset();
+
+	}
+
+	/*
+	 * empty grammar: rule 0 (the top-level rule) with an empty body
+	 */
+	void reset(){
+
+		vector<node>().swap(nodes);
+		vector<itype>().swap(free_nodes);
+		vector<itype>().swap(guard);
+		vector<itype>().swap(uses);
+		vector<itype>().swap(free_rules);
+		unordered_map<pair_key_t,itype,pair_key_hash>().swap(digrams);
+
+		n_symbols = 0;
+
+		new_rule();
+
+	}
+
+	vector<node> nodes;
+	vector<itype> free_nodes;
+
+	vector<itype> guard; //guard node of each rule
+	vector<itype> uses; //number of rule symbols of each rule
+	vector<itype> free_rules;
+
+	unordered_map<pair_key_t,itype,pair_key_hash> digrams; //digram -> its first node
+
+	uint64_t n_symbols = 0; //non-guard nodes
+	uint64_t max_symbols = 0;
+
+	uint64_t blocks = 0;
+	vector<bool> present = vector<bool>(256,false); //characters of the text
+
+	bool finished = false;
+
+};
+
+template<typename itype> const itype sequitur<itype>::NIL;
+template<typename itype> const itype sequitur<itype>::GUARD;
+
+#endif /* INTERNAL_SEQUITUR_HPP_ */
@@ -30,6 +30,8 @@
 
 #include <vector>
 
+#include "pair_key.hpp"
+
 using namespace std;
 
 template<typename itype = uint32_t, typename ctype = uint32_t>
@@ -129,6 +131,34 @@ public:
 	}
 
 
+	/*
+	 * packed key (see pair_key.hpp) of the pair starting at position i < n; NULLKEY if there is
+	 * no such pair
+	 */
+	pair_key_t key_starting_at(itype i){
+
+		assert(i<T.size());
+
+		itype i_1 = is_blank(i) ? null : next_non_blank_position(i);
+
+		return i_1 == null ? NULLKEY : pack_pair(at(i),at(i_1));
+
+	}
+
+	/*
+	 * return the first non-blank position after non-blank position i (size() if there is none)
+	 */
+	itype next_position(itype i){
+
+		assert(not is_blank(i));
+		assert(i<T.size());
+
+		itype i_1 = next_non_blank_position(i);
+
+		return i_1 == null ? T.size() : i_1;
+
+	}
+
 	/*
 	 * return pair that follows pair starting at position i
 	 *
@@ -255,6 +285,45 @@ public:
 
 	}
 
+	/*
+	 * rename every non-blank character c with new_symbol[c]. The mapping must be injective on the
+	 * characters in the text. Used to densify the alphabet after some pairs have been replaced
+	 */
+	void remap(const vector<ctype> & new_symbol){
+
+		max_symbol = 0;
+
+		for(itype i = 0;i<n;++i){
+
+			if(not is_blank(i)){
+
+				ctype c = new_symbol[at(i)];
+
+				assert(c != BLANK);
+
+				if(i < n-1 and is_blank(i+1)){
+
+					//32-bit character stored in T[i]T[i+1]
+					T[i] = uint32_t(c) >> 16;
+					T[i+1] = uint32_t(c) & ((uint32_t(1)<<16)-1);
+
+				}else{
+
+					assert(c <= ~uint16_t(0));
+					T[i] = c;
+
+				}
+
+				assert(at(i) == c);
+
+				max_symbol = c>max_symbol ? c : max_symbol;
+
+			}
+
+		}
+
+	}
+
 	/*
 	 * return size of the text including blank characters
 	 */
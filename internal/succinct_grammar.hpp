@@ -0,0 +1,319 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * succinct_grammar.hpp
+ *
+ *  Created on: Mar 23, 2017
+ *      Author: nico
+ *
+ *  compact in-memory Re-Pair grammar for query processes. Same symbols and query interface as
+ *  grammar.hpp (so it can replace it in grammar_index and grammar_fingerprints), but:
+ *
+ *  - the rules' children and Tc are packed at ceil(log2(sigma+g)) bits per symbol;
+ *  - the expansion lengths are packed at ceil(log2(n+1)) bits per symbol;
+ *  - the starting text position of every sample-th Tc symbol is stored (packed).
+ *
+ *  Space: g (2 log(sigma+g) + log n) + |Tc| (log(sigma+g) + log(n)/sample) bits, versus
+ *  g (2w + 64) + |Tc| w bits for grammar.hpp with w-bit symbols.
+ *
+ *  Supported operations:
+ *
+ *  rule(X), length(X): Complexity: O(1)
+ *  extract(i,l): text[i,...,i+l-1]. Complexity: O(log(|Tc|/sample) + sample + h + l), h = grammar height
+ *
+ */
+
+#ifndef INTERNAL_SUCCINCT_GRAMMAR_HPP_
+#define INTERNAL_SUCCINCT_GRAMMAR_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "packed_array.hpp"
+#include "rp_archive.hpp"
+#include "word_tokenizer.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class succinct_grammar{
+
+public:
+
+	using ipair = pair<itype,itype>;
+
+	succinct_grammar(){}
+
+	/*
+	 * build the grammar stored in archive arc (its A, G and T are released). The starting
+	 * position of one Tc symbol every sample is stored
+	 */
+	succinct_grammar(rp_archive<itype> & arc, uint64_t sample = 64){
+
+		assert(sample > 0);
+
+		this->sample = sample;
+
+		sigma = arc.A.size();
+		g = arc.G.size();
+
+		tokens = arc.has_section(RP_SECTION_TOKENS);
+
+		auto dictionary = tokens ? word_tokenizer<itype>::dictionary_from_payload(arc.section(RP_SECTION_TOKENS)) : vector<string>();
+
+		for(auto a : arc.A){
+
+			assert(not tokens or a < dictionary.size());
+			terminals.push_back(tokens ? dictionary[a] : string(1,char(a)));
+
+		}
+
+		dictionary = {};
+		vector<itype>().swap(arc.A);
+
+		uint64_t w = packed_array::width(sigma+g > 0 ? sigma+g-1 : 0);
+
+		rules = packed_array(2*g,w);
+
+		for(uint64_t r=0;r<g;++r){
+
+			rules.set(2*r,arc.G[r].first);
+			rules.set(2*r+1,arc.G[r].second);
+
+		}
+
+		vector<ipair>().swap(arc.G);
+
+		Tc = packed_array(arc.T.size(),w);
+
+		for(uint64_t j=0;j<arc.T.size();++j) Tc.set(j,arc.T[j]);
+
+		vector<itype>().swap(arc.T);
+
+		//expansion lengths, bottom-up
+		{
+			vector<uint64_t> l(sigma+g);
+
+			for(itype X=0;X<sigma+g;++X){
+
+				if(is_terminal(X)){
+
+					l[X] = terminals[X].size();
+
+				}else{
+
+					auto ab = rule(X);
+
+					assert(ab.first < X and ab.second < X);
+
+					l[X] = l[ab.first] + l[ab.second];
+
+				}
+
+			}
+
+			n = 0;
+			for(uint64_t j=0;j<Tc.size();++j) n += l[Tc[j]];
+
+			len = packed_array(l.size(),packed_array::width(n));
+
+			for(uint64_t X=0;X<l.size();++X) len.set(X,l[X]);
+		}
+
+		starts = packed_array(Tc.size()/sample + 1,packed_array::width(n));
+
+		uint64_t s = 0;
+
+		for(uint64_t j=0;j<Tc.size();++j){
+
+			if(j % sample == 0) starts.set(j/sample,s);
+			s += len[Tc[j]];
+
+		}
+
+		if(Tc.size() % sample == 0) starts.set(Tc.size()/sample,s);
+
+	}
+
+	itype alphabet_size(){
+		return sigma;
+	}
+
+	itype number_of_rules(){
+		return g;
+	}
+
+	itype number_of_symbols(){
+		return sigma + g;
+	}
+
+	bool is_terminal(itype X){
+		return X < sigma;
+	}
+
+	bool has_tokens(){
+		return tokens;
+	}
+
+	/*
+	 * expansion of terminal X
+	 */
+	const string & terminal_string(itype X){
+
+		assert(is_terminal(X));
+		return terminals[X];
+
+	}
+
+	/*
+	 * right-hand side of rule X
+	 */
+	ipair rule(itype X){
+
+		assert(not is_terminal(X));
+		assert(X - sigma < g);
+
+		uint64_t r = X - sigma;
+
+		return {itype(rules[2*r]),itype(rules[2*r+1])};
+
+	}
+
+	/*
+	 * length of the expansion of symbol X
+	 */
+	uint64_t length(itype X){
+
+		assert(X < number_of_symbols());
+		return len[X];
+
+	}
+
+	/*
+	 * the compressed text (packed)
+	 */
+	const packed_array & text(){
+		return Tc;
+	}
+
+	uint64_t text_length(){
+		return n;
+	}
+
+	/*
+	 * text[i,...,i+l-1]
+	 */
+	string extract(uint64_t i, uint64_t l){
+
+		assert(i+l <= n);
+
+		string out;
+
+		if(l == 0) return out;
+
+		//last sampled Tc symbol starting at or before i, then the Tc symbol containing i
+		uint64_t lo = 0;
+		uint64_t hi = (Tc.size()+sample-1)/sample; //number of sampled Tc symbols
+
+		while(hi - lo > 1){
+
+			uint64_t mid = (lo+hi)/2;
+
+			if(starts[mid] <= i) lo = mid; else hi = mid;
+
+		}
+
+		uint64_t j = lo*sample;
+		uint64_t start = starts[lo];
+
+		while(start + len[Tc[j]] <= i) start += len[Tc[j++]];
+
+		uint64_t skip = i - start; //characters of Tc[j] before position i
+
+		//<symbol, characters to skip in its expansion>
+		vector<pair<itype,uint64_t> > S;
+
+		for(;out.size() < l;++j){
+
+			S.push_back({itype(Tc[j]),skip});
+			skip = 0;
+
+			while(not S.empty() and out.size() < l){
+
+				itype X = S.back().first;
+				uint64_t s = S.back().second;
+				S.pop_back();
+
+				if(is_terminal(X)){
+
+					const string & w = terminals[X];
+					out.append(w,s,std::min(uint64_t(w.size())-s,l-out.size()));
+
+				}else{
+
+					auto ab = rule(X);
+					uint64_t la = len[ab.first];
+
+					if(s >= la){
+
+						S.push_back({ab.second,s-la});
+
+					}else{
+
+						S.push_back({ab.second,0});
+						S.push_back({ab.first,s});
+
+					}
+
+				}
+
+			}
+
+		}
+
+		return out;
+
+	}
+
+	/*
+	 * memory used by the grammar, in Bytes (terminal strings excluded)
+	 */
+	uint64_t bytes(){
+		return rules.bytes() + Tc.bytes() + len.bytes() + starts.bytes();
+	}
+
+private:
+
+	itype sigma = 0;
+	itype g = 0;
+
+	bool tokens = false; //true iff terminals are dictionary tokens
+	vector<string> terminals; //expansion of each terminal
+
+	packed_array rules; //children of rule sigma+r at positions 2r, 2r+1
+	packed_array Tc;
+	packed_array len; //expansion lengths
+	packed_array starts; //starts[k] = text position of Tc[k*sample]
+
+	uint64_t sample = 64;
+
+	//expanded text length
+	uint64_t n = 0;
+
+};
+
+#endif /* INTERNAL_SUCCINCT_GRAMMAR_HPP_ */
@@ -26,8 +26,11 @@
 #define INTERNAL_TEXT_POSITIONS_HPP_
 
 #include <algorithm>
+#include <cmath>
 #include "skippable_text.hpp"
+#include "pair_key.hpp"
 #include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -44,63 +47,88 @@ public:
 	 * build new array of text positions with only text positions of pairs with
 	 * frequency at least min_freq
 	 *
-	 * assumption: input text is ASCII (max char = 255)
+	 * assumption: the text contains no blanks
 	 *
-	 * if max_alphabet_size>0, build table of max_alphabet_size x max_alphabet_size entries to speed-up
-	 * pair sorting.
+	 * a direct-address table of w x w entries is used to speed-up pair sorting, where w is
+	 * max_symbol+1 rounded up. The table is allocated lazily and never uses more than
+	 * hash_budget Bytes (default: n/8, at least 1 MB); if the symbols do not fit, pair sorting
+	 * falls back to a hash with collision resolution.
+	 *
+	 * If not empty, pair_freq (k x k, row-major) contains the frequencies of the pairs of the k symbols
+	 * with frequency at least min_freq, in increasing symbol order: then pairs are not counted again.
+	 *
+	 * Otherwise pairs are counted in a k x k table. Since k <= n/min_freq = n^(1-alpha), the table takes
+	 * O(n^(2-2alpha)) = O(n^0.68) words for alpha = 0.66, always less than the hash budget: a sketch of the
+	 * frequent pairs (e.g. Misra-Gries) would never be used. TP holds only positions of frequent pairs.
 	 *
 	 */
-	text_positions(skippable_text<itype,ctype> * T, itype min_freq){
-
-		//hash will be of size maxd*maxd words
-		uint64_t maxd = std::max(uint64_t(std::pow(  T->size(), 0.4  )),uint64_t(T->get_max_symbol()+1));
-
-		//hash to accelerate pair sorting
-		H = vector<vector<ipair> >(maxd,vector<ipair>(maxd,{0,0}));
+	text_positions(skippable_text<itype,ctype> * T, itype min_freq, uint64_t hash_budget = 0, const vector<itype> & pair_freq = {}){
 
 		this->T = T;
 
 		assert(T->size()>1);
 
-		//frequency of every possible ASCII pair
-		auto F = vector<vector<itype> >(256,vector<itype>(256,0));
+		hash_budget = hash_budget == 0 ? std::max(uint64_t(1)<<20, uint64_t(T->size())/8) : hash_budget;
+		max_hash_width = std::sqrt(double(hash_budget)/sizeof(ipair));
 
-		//count frequencies
-		for(itype i = 0;i<T->size()-1;++i){
+		//key cache uses at most n Bytes (8 Bytes per cached key)
+		max_cached_keys = std::max(uint64_t(1)<<16, uint64_t(T->size())/8);
 
-			cpair p = T->pair_starting_at(i);
-			ctype a = p.first;
-			ctype b = p.second;
+		/*
+		 * a pair can be frequent only if both its symbols are: count symbol frequencies and
+		 * rank the k frequent symbols (k <= n/min_freq, k <= 256 on ASCII texts)
+		 */
+		const itype null = ~itype(0);
 
-			assert(p != T->blank_pair());
+		vector<itype> rank(T->get_max_symbol()+1,0);
 
-			assert(a<256);
-			assert(b<256);
+		for(itype i = 0;i<T->size();++i) rank[(*T)[i]]++;
 
-			F[a][b]++;
+		itype k = 0;
 
-		}
+		for(auto & r : rank) r = r >= min_freq ? k++ : null;
 
-		const itype null = ~itype(0);
+		//frequency of every pair of frequent symbols
+		auto F = pair_freq.size() > 0 ? pair_freq : vector<itype>(uint64_t(k)*k,0);
 
-		itype hf_pairs = 0;
+		assert(F.size() == uint64_t(k)*k);
+
+		auto cell = [&](pair_key_t p){
 
-		for(ctype a = 0;a<256;++a){
+			itype a = rank[key_first(p)];
+			itype b = rank[key_second(p)];
 
-			for(ctype b = 0;b<256;++b){
+			return a == null or b == null ? null : a*k + b;
 
-				itype t = F[a][b];
+		};
 
-				if(F[a][b] < min_freq){
+		//count frequencies
+		for(itype i = 0;i<T->size()-1 and pair_freq.size() == 0;++i){
 
-					F[a][b] = null;
+			pair_key_t p = T->key_starting_at(i);
 
-				}else{
+			assert(p != NULLKEY);
 
-					F[a][b] = hf_pairs;
-					hf_pairs += t;
+			itype c = cell(p);
 
-				}
+			if(c != null) F[c]++;
+
+		}
+
+		itype hf_pairs = 0;
+
+		for(auto & f : F){
+
+			itype t = f;
+
+			if(f < min_freq){
+
+				f = null;
+
+			}else{
+
+				f = hf_pairs;
+				hf_pairs += t;
 
 			}
 
@@ -112,19 +140,14 @@ public:
 		//fill TP: cluster high-freq pairs
 		for(itype i = 0;i<T->size()-1;++i){
 
-			cpair p = T->pair_starting_at(i);
-			ctype a = p.first;
-			ctype b = p.second;
+			itype c = cell(T->key_starting_at(i));
 
-			assert(a<256);
-			assert(b<256);
+			if(c != null and F[c] != null){//if ab is a high-freq pair
 
-			if(F[a][b] != null){//if ab is a high-freq pair
+				assert(F[c] < TP.size());
 
-				assert(F[a][b] < TP.size());
-
-				//store i at position F[a][b], increment F[a][b]
-				TP[ F[a][b]++ ] = i;
+				//store i at position F[c], increment F[c]
+				TP[ F[c]++ ] = i;
 
 			}
 
@@ -184,209 +207,259 @@ public:
 
 		/*
 		 * if the largest symbol in the text is too big for the hash,
-		 * just apply slow comparison-sort
+		 * use a hash with collision resolution
 		 */
-		if(T->get_max_symbol() >= H.size()){
+		if(not fit_hash(T->get_max_symbol()+1)){
 
 			cluster1(i,j);
-			//nlogn_sort(i,j);
 			assert(is_clustered(i,j));
 			return;
 
 		}
 
-		assert(i<size());
-		assert(j<=size());
-		assert(i<j);
-
-		//mark in a bitvector only one position per distinct pair
-		auto distinct_pair_positions = vector<bool>(j-i,false);
+		direct_table D = {&H, hash_width};
+		cluster_kernel(i,j,D);
 
-		//first step: count frequencies
+		//restore H
 		for(itype k = i; k<j; ++k){
 
-			if(not T->is_blank(TP[k])){
-
-				cpair ab = T->pair_starting_at(TP[k]);
-				ctype a = ab.first;
-				ctype b = ab.second;
-
-				if(ab != nullpair ){
-
-					assert(a<H.size());
-					assert(b<H.size());
+			if(distinct_pair_positions[k-i]){
 
-					//write a '1' iff this is the first time we see this pair
-					distinct_pair_positions[k-i] = (H[a][b].first==0);
+				uint64_t ab = key_at(i,k);
 
-					H[a][b].first++;
+				assert(ab != NULLKEY);
 
-				}
+				D[ab] = {0,0};
 
 			}
 
 		}
 
-		itype t = i;//cumulated freq
-
-		//second step: cumulate frequencies
-		for(itype k = i; k<j; ++k){
+		assert(is_clustered(i,j));
 
-			if(distinct_pair_positions[k-i]){
+	}
 
-				cpair ab = T->pair_starting_at(TP[k]);
-				ctype a = ab.first;
-				ctype b = ab.second;
 
-				assert(ab != nullpair);
+	/*
+	 * cluster TP[i,...,j-1] by character pairs.
+	 * This procedure uses a hash with collision resolution
+	 * to deal with large symbols
+	 */
+	void cluster1(itype i, itype j){
 
-				assert(a<H.size());
-				assert(b<H.size());
+		hash_table H1;
+		cluster_kernel(i,j,H1);
 
-				itype temp = H[a][b].first;
+		assert(is_clustered(i,j));
 
-				H[a][b].first = t;
-				H[a][b].second = t;
+	}
 
-				t += temp;
 
-			}
+	/*
+	 * cluster all array
+	 */
+	void cluster(){
 
-		}
+		cluster(0,size());
 
-		//itype dist_pairs = 0;
+	}
 
-		//clear bitvector content
-		for(itype k = i; k<j;++k) distinct_pair_positions[k-i] = false;
+	void nlogn_sort(){
+		nlogn_sort(0,size());
+	}
 
-		//t is the starting position of null pairs
+	itype size(){
 
-		itype null_start = t;
+		return TP.size();
 
-		//third step: cluster
-		itype k = i; //current position in TP
+	}
 
-		//invariant: TP[i,...,k] is clustered
-		while(k<j){
+	/*
+	 * free the direct-address hash. It will be re-allocated (sized on the symbols
+	 * in the text at that point) by the next cluster operation
+	 */
+	void release_hash(){
 
-			cpair ab = T->pair_starting_at(TP[k]);
-			ctype a = ab.first;
-			ctype b = ab.second;
+		H = vector<ipair>();
+		hash_width = 0;
 
-			itype ab_start;
-			itype ab_end;
+	}
 
-			if(ab==nullpair){
+	/*
+	 * current and peak size in Bytes of the direct-address hash
+	 */
+	uint64_t hash_bytes(){
+		return H.size()*sizeof(ipair);
+	}
 
-				ab_start = null_start;
-				ab_end = t;
+	uint64_t peak_hash_bytes(){
+		return peak_hash;
+	}
 
-			}else{
+	/*
+	 * check that TP[i,...,j-1] is clustered by character pairs
+	 */
+	bool is_clustered(itype i, itype j){
 
-				ab_start = H[a][b].first;
-				ab_end = H[a][b].second;
+		if(j<=i) return true;
 
-			}
+		itype m = j-i;
 
-			if(k >= ab_start and k <= ab_end){
+		auto V = unordered_set<pair_key_t,pair_key_hash>(2*m);
 
-				//if k is the first position where a distinct pair (other than nullpair)
-				//is seen in the sorted vector, mark it on distinct_pair_positions
-				distinct_pair_positions[k-i] = (k==ab_start and ab!=nullpair);
+		for(itype k=i+1;k<j;++k){
 
-				//dist_pairs += distinct_pair_positions[k-i];
+			if(T->key_starting_at(TP[k]) != T->key_starting_at(TP[k-1])){
 
-				//case 1: ab is the right place: increment k
-				k++;
+				auto p = T->key_starting_at(TP[k-1]);
 
-				if(ab==nullpair){
+				//new pair: check that previous pair is not in V
+				if(V.count(p) == 0){
 
-					t += (ab_end == k);
+					V.insert(p);
 
 				}else{
 
-					//if k is exactly next ab position, increment next ab position
-					H[a][b].second += (ab_end == k);
+					//we have already seen this pair: array is not clustered
+					return false;
 
 				}
 
-			}else{
+			}
 
-				//ab has to go to ab_end. swap TP[k] and TP[ab_end]
-				itype temp = TP[k];
-				TP[k] = TP[ab_end];
-				TP[ab_end] = temp;
+		}
 
-				if(ab==nullpair){
+		auto p = T->key_starting_at(TP[j-1]);
 
-					t++;
+		//new pair: check that last pair is not in V
+		if(V.count(p) != 0) return false;
 
-				}else{
+		return true;
 
-					//move forward ab_end since we inserted an ab on top of the list of ab's
-					H[a][b].second++;
+	}
 
-				}
+	/*
+	 * true iff TP[i,...,j-1] contains only pair ab. Return true if range [i,j-1] is empty
+	 */
+	bool contains_only(itype i, itype j, pair_key_t ab){
 
-			}
+		for(itype k=i;k<j;++k){
+
+			if(T->key_starting_at(TP[k]) != ab) return false;
 
 		}
 
-		//restore H
-		for(itype k = i; k<j; ++k){
+		return true;
 
-			if(distinct_pair_positions[k-i]){
+	}
 
-				cpair ab = T->pair_starting_at(TP[k]);
-				ctype a = ab.first;
-				ctype b = ab.second;
+private:
 
-				assert(ab!=nullpair);
+	/*
+	 * make sure the direct-address hash can store pairs of symbols smaller than w, growing it if needed.
+	 * Return false if this would exceed the memory budget
+	 */
+	bool fit_hash(uint64_t w){
 
-				H[a][b] = {0,0};
+		if(w <= hash_width) return true;
+		if(w > max_hash_width) return false;
 
-			}
+		//leave room for symbols created later, so that the table is re-allocated O(log) times
+		hash_width = std::min(max_hash_width, std::max(uint64_t(256), w + w/2));
 
-		}
+		H = vector<ipair>();
+		H = vector<ipair>(hash_width*hash_width,{0,0});
 
-		assert(is_clustered(i,j));
+		peak_hash = std::max(peak_hash,hash_bytes());
+
+		return true;
 
 	}
 
+	/*
+	 * key of the pair starting at TP[k], where TP[i,...,j-1] is the range being clustered.
+	 * The key is read from the cache if it has been computed by cluster_kernel
+	 */
+	uint64_t key_at(itype i, itype k){
+
+		return cached ? K[k-i] : T->key_starting_at(TP[k]);
+
+	}
 
 	/*
-	 * cluster TP[i,...,j-1] by character pairs.
-	 * This procedure uses a hash with collision resolution
-	 * to deal with large symbols
+	 * cluster tables mapping a pair key to <begin, end>. Entries of pairs not yet seen must read {0,0}
 	 */
-	void cluster1(itype i, itype j){
+	struct direct_table{
+
+		ipair & operator[](uint64_t ab){
+
+			assert((ab >> 32) < width);
+			assert(uint32_t(ab) < width);
+
+			return (*H)[(ab >> 32)*width + uint32_t(ab)];
+
+		}
+
+		vector<ipair> * H;
+		uint64_t width;
+
+	};
 
-		unordered_map<cpair,ipair> H1;
+	struct hash_table{
+
+		ipair & operator[](uint64_t ab){
+
+			return H[ab];
+
+		}
+
+		unordered_map<pair_key_t,ipair,pair_key_hash> H;
+
+	};
+
+	/*
+	 * cluster TP[i,...,j-1] by character pairs using table H.
+	 *
+	 * The pair key of each element is computed once and kept aligned with TP while
+	 * swapping, so that the text is accessed only once per element (key_starting_at
+	 * walks the non-blank bitvector). The cache is not used for very large ranges,
+	 * to keep the temporary memory small.
+	 *
+	 * on exit, distinct_pair_positions[k-i] = true iff k is the first position of a distinct pair in TP[i,...,j-1]
+	 */
+	template<typename table_t>
+	void cluster_kernel(itype i, itype j, table_t & H){
 
 		assert(i<size());
 		assert(j<=size());
 		assert(i<j);
 
+		cached = (j-i) <= max_cached_keys;
+
+		if(cached){
+
+			K.resize(j-i);
+
+			for(itype k = i; k<j; ++k) K[k-i] = T->key_starting_at(TP[k]);
+
+		}
+
 		//mark in a bitvector only one position per distinct pair
-		auto distinct_pair_positions = vector<bool>(j-i,false);
+		distinct_pair_positions = vector<bool>(j-i,false);
 
 		//first step: count frequencies
 		for(itype k = i; k<j; ++k){
 
-			if(not T->is_blank(TP[k])){
-
-				cpair ab = T->pair_starting_at(TP[k]);
-
-				if(ab != nullpair ){
+			uint64_t ab = key_at(i,k);
 
-					//write a '1' iff this is the first time we see this pair
-					distinct_pair_positions[k-i] = (H1.count(ab)==0);
+			if(ab != NULLKEY){
 
-					if(H1.count(ab)==0) H1[ab] = {0,0};
+				ipair & e = H[ab];
 
-					H1[ab].first++;
+				//write a '1' iff this is the first time we see this pair
+				distinct_pair_positions[k-i] = (e.first==0);
 
-				}
+				e.first++;
 
 			}
 
@@ -399,14 +472,16 @@ public:
 
 			if(distinct_pair_positions[k-i]){
 
-				cpair ab = T->pair_starting_at(TP[k]);
+				uint64_t ab = key_at(i,k);
+
+				assert(ab != NULLKEY);
 
-				assert(ab != nullpair);
+				ipair & e = H[ab];
 
-				itype temp = H1[ab].first;
+				itype temp = e.first;
 
-				H1[ab].first = t;
-				H1[ab].second = t;
+				e.first = t;
+				e.second = t;
 
 				t += temp;
 
@@ -427,20 +502,22 @@ public:
 		//invariant: TP[i,...,k] is clustered
 		while(k<j){
 
-			cpair ab = T->pair_starting_at(TP[k]);
+			uint64_t ab = key_at(i,k);
 
 			itype ab_start;
 			itype ab_end;
 
-			if(ab==nullpair){
+			if(ab==NULLKEY){
 
 				ab_start = null_start;
 				ab_end = t;
 
 			}else{
 
-				ab_start = H1[ab].first;
-				ab_end = H1[ab].second;
+				ipair & e = H[ab];
+
+				ab_start = e.first;
+				ab_end = e.second;
 
 			}
 
@@ -448,96 +525,39 @@ public:
 
 				//if k is the first position where a distinct pair (other than nullpair)
 				//is seen in the sorted vector, mark it on distinct_pair_positions
-				distinct_pair_positions[k-i] = (k==ab_start and ab!=nullpair);
-
-				//dist_pairs += distinct_pair_positions[k-i];
+				distinct_pair_positions[k-i] = (k==ab_start and ab!=NULLKEY);
 
 				//case 1: ab is the right place: increment k
 				k++;
 
-				if(ab==nullpair){
+				if(ab==NULLKEY){
 
 					t += (ab_end == k);
 
 				}else{
 
 					//if k is exactly next ab position, increment next ab position
-					H1[ab].second += (ab_end == k);
+					H[ab].second += (ab_end == k);
 
 				}
 
 			}else{
 
-				//ab has to go to ab_end. swap TP[k] and TP[ab_end]
+				//ab has to go to ab_end. swap TP[k] and TP[ab_end] (and their keys)
 				itype temp = TP[k];
 				TP[k] = TP[ab_end];
 				TP[ab_end] = temp;
 
-				if(ab==nullpair){
+				if(cached) std::swap(K[k-i],K[ab_end-i]);
+
+				if(ab==NULLKEY){
 
 					t++;
 
 				}else{
 
 					//move forward ab_end since we inserted an ab on top of the list of ab's
-					H1[ab].second++;
-
-				}
-
-			}
-
-		}
-
-		assert(is_clustered(i,j));
-
-	}
-
-
-	/*
-	 * cluster all array
-	 */
-	void cluster(){
-
-		cluster(0,size());
-
-	}
-
-	void nlogn_sort(){
-		nlogn_sort(0,size());
-	}
-
-	itype size(){
-
-		return TP.size();
-
-	}
-
-	/*
-	 * check that TP[i,...,j-1] is clustered by character pairs
-	 */
-	bool is_clustered(itype i, itype j){
-
-		if(j<=i) return true;
-
-		itype m = j-i;
-
-		auto V = unordered_map<cpair,bool>(2*m);
-
-		for(itype k=i+1;k<j;++k){
-
-			if(T->pair_starting_at(TP[k]) != T->pair_starting_at(TP[k-1])){
-
-				auto p = T->pair_starting_at(TP[k-1]);
-
-				//new pair: check that previous pair is not in V
-				if(V.count(p) == 0){
-
-					V.insert({p,true});
-
-				}else{
-
-					//we have already seen this pair: array is not clustered
-					return false;
+					H[ab].second++;
 
 				}
 
@@ -545,32 +565,8 @@ public:
 
 		}
 
-		auto p = T->pair_starting_at(TP[j-1]);
-
-		//new pair: check that last pair is not in V
-		if(V.count(p) != 0) return false;
-
-		return true;
-
-	}
-
-	/*
-	 * true iff TP[i,...,j-1] contains only pair ab. Return true if range [i,j-1] is empty
-	 */
-	bool contains_only(itype i, itype j, cpair ab){
-
-		for(itype k=i;k<j;++k){
-
-			if(T->pair_starting_at(TP[k]) != ab) return false;
-
-		}
-
-		return true;
-
 	}
 
-private:
-
 	struct comparator {
 
 		comparator(skippable_text<itype,ctype> * T){
@@ -581,7 +577,7 @@ private:
 
 		bool operator () (int i, int j){
 
-			return T->pair_starting_at(i) < T->pair_starting_at(j);
+			return T->key_starting_at(i) < T->key_starting_at(j);
 
 		}
 
@@ -593,12 +589,23 @@ private:
 	skippable_text<itype,ctype> * T;
 
 	//hash to speed-up pair sorting (to linear time)
-	vector<vector<ipair> > H; //H[a][b] = <begin, end>. end = next position where to store ab
+	vector<ipair> H; //H[a*hash_width+b] = <begin, end>. end = next position where to store ab
+	uint64_t hash_width = 0;
+	uint64_t max_hash_width = 0; //largest width allowed by the memory budget
+	uint64_t peak_hash = 0;
 
 	//the array of text positions
 	//int_vector<> TP;
 	vector<itype> TP;
 
+	//cache of pair keys for the range being clustered (see cluster_kernel)
+	vector<uint64_t> K;
+	bool cached = false;
+	uint64_t max_cached_keys = 0;
+
+	//marks the first position of every distinct pair in the last clustered range
+	vector<bool> distinct_pair_positions;
+
 	const itype null = ~itype(0);
 	const cpair nullpair = {null,null};
 
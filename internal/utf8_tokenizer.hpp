@@ -0,0 +1,231 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * utf8_tokenizer.hpp
+ *
+ *  Created on: Mar 22, 2017
+ *      Author: nico
+ *
+ *  splits a UTF-8 text into code points and assigns them dense integer ids, so that Re-Pair runs on
+ *  the (shorter) sequence of code points instead of rebuilding every multi-byte character pair by pair.
+ *
+ *  A byte that does not start a well-formed sequence (RFC 3629: no overlong forms, surrogates or
+ *  code points above U+10FFFF) is an escape: it becomes a single-byte token, so any input is
+ *  restored exactly. At most MAX_TOKENS ids are used: if there are more distinct code points, the
+ *  rarest ones are spelled byte by byte with escape tokens. Ids are < 2^16, as required by the
+ *  Re-Pair engine.
+ *
+ *  The token of a code point is its UTF-8 encoding, and the dictionary is stored in archive section
+ *  RP_SECTION_TOKENS with the layout of word_tokenizer.hpp. Terminals thus expand to their bytes
+ *  directly, and every command supporting word-token archives supports these archives too.
+ *
+ */
+
+#ifndef INTERNAL_UTF8_TOKENIZER_HPP_
+#define INTERNAL_UTF8_TOKENIZER_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <istream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32c.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class utf8_tokenizer{
+
+public:
+
+	static const itype MAX_TOKENS = itype(1)<<15;
+
+	/*
+	 * tokenize the content of stream in. Return the sequence of token ids; the dictionary, the
+	 * CRC32C and the length of the text are stored in this object
+	 */
+	vector<itype> tokenize(istream & in){
+
+		string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+		text_length = text.size();
+		text_crc = crc32c::update(0,(const uint8_t*)text.data(),text.size());
+
+		//length in bytes of the code point starting at each token boundary (1 for escapes)
+		vector<uint8_t> len;
+
+		for(uint64_t i=0;i<text.size();i+=len.back()){
+
+			len.push_back(sequence_length(text,i));
+
+			if(len.back() == 0){
+
+				len.back() = 1;
+				escapes++;
+
+			}
+
+		}
+
+		unordered_map<string,uint64_t> freq;
+
+		for(uint64_t t=0,i=0;t<len.size();i+=len[t++]){
+
+			if(len[t] > 1) freq[text.substr(i,len[t])]++;
+
+		}
+
+		//multi-byte code points, by decreasing frequency
+		vector<pair<uint64_t,string> > candidates;
+
+		for(auto & e : freq) candidates.push_back({e.second,e.first});
+
+		freq = {};
+
+		std::sort(candidates.begin(),candidates.end(),[](const pair<uint64_t,string> & a, const pair<uint64_t,string> & b){
+
+			return a.first > b.first or (a.first == b.first and a.second < b.second);
+
+		});
+
+		//256 ids are kept for single bytes (ASCII characters and escapes)
+		if(candidates.size() > MAX_TOKENS-256) candidates.resize(MAX_TOKENS-256);
+
+		dictionary = {};
+		unordered_map<string,itype> id;
+
+		for(auto & c : candidates){
+
+			id[c.second] = dictionary.size();
+			dictionary.push_back(c.second);
+
+		}
+
+		code_points = dictionary.size();
+
+		candidates = {};
+
+		vector<itype> S;
+
+		auto emit = [&](const string & w){
+
+			auto it = id.find(w);
+
+			if(it == id.end()){
+
+				it = id.insert({w,itype(dictionary.size())}).first;
+				dictionary.push_back(w);
+
+			}
+
+			S.push_back(it->second);
+
+		};
+
+		for(uint64_t t=0,i=0;t<len.size();i+=len[t++]){
+
+			string w = text.substr(i,len[t]);
+
+			if(w.size() == 1 or id.count(w) == 1){
+
+				emit(w);
+
+			}else{
+
+				for(auto c : w) emit(string(1,c));
+
+			}
+
+		}
+
+		assert(dictionary.size() <= MAX_TOKENS);
+
+		return S;
+
+	}
+
+	/*
+	 * serialize the dictionary (payload of section RP_SECTION_TOKENS, see word_tokenizer.hpp)
+	 */
+	vector<itype> dictionary_payload(){
+
+		vector<itype> payload = {itype(dictionary.size())};
+
+		for(auto & w : dictionary) payload.push_back(w.size());
+		for(auto & w : dictionary) for(auto c : w) payload.push_back(uint8_t(c));
+
+		return payload;
+
+	}
+
+	vector<string> dictionary;
+
+	uint32_t text_crc = 0;
+	uint64_t text_length = 0;
+
+	uint64_t escapes = 0; //malformed bytes
+	uint64_t code_points = 0; //distinct multi-byte code points with their own id
+
+private:
+
+	/*
+	 * length of the well-formed UTF-8 sequence starting at text[i], or 0 if there is none
+	 */
+	static uint8_t sequence_length(const string & text, uint64_t i){
+
+		uint8_t c = text[i];
+
+		if(c < 0x80) return 1;
+
+		uint8_t l;
+		uint8_t lo = 0x80; //range of the second byte
+		uint8_t hi = 0xBF;
+
+		if(c >= 0xC2 and c <= 0xDF) l = 2;
+		else if(c >= 0xE0 and c <= 0xEF) l = 3;
+		else if(c >= 0xF0 and c <= 0xF4) l = 4;
+		else return 0;
+
+		if(c == 0xE0) lo = 0xA0; //overlong
+		if(c == 0xED) hi = 0x9F; //surrogates
+		if(c == 0xF0) lo = 0x90; //overlong
+		if(c == 0xF4) hi = 0x8F; //above U+10FFFF
+
+		if(i+l > text.size()) return 0;
+
+		uint8_t c1 = text[i+1];
+
+		if(c1 < lo or c1 > hi) return 0;
+
+		for(uint8_t k=2;k<l;++k){
+
+			uint8_t ck = text[i+k];
+
+			if(ck < 0x80 or ck > 0xBF) return 0;
+
+		}
+
+		return l;
+
+	}
+
+};
+
+template<typename itype> const itype utf8_tokenizer<itype>::MAX_TOKENS;
+
+#endif /* INTERNAL_UTF8_TOKENIZER_HPP_ */
@@ -0,0 +1,211 @@
+/*
+ *  This file is part of Re-Pair.
+ *  Copyright (c) by
+ *  Nicola Prezza <nicola.prezza@gmail.com>, Philip Bille, and Inge Li Gørtz
+ *
+ *   Re-Pair is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+
+ *   Re-Pair is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details (<http://www.gnu.org/licenses/>).
+ *
+ * word_tokenizer.hpp
+ *
+ *  Created on: Mar 10, 2017
+ *      Author: nico
+ *
+ *  splits a text into word tokens (maximal runs of letters, digits, '_' and non-ASCII bytes) and
+ *  separator tokens (maximal runs of the other characters), and assigns them dense integer ids.
+ *
+ *  Only tokens occurring at least twice get their own id, at most MAX_TOKENS in total (the most
+ *  frequent ones); the others are spelled character by character with single-character tokens.
+ *  Ids are < 2^16, as required by the Re-Pair engine.
+ *
+ *  The dictionary is stored in archive section RP_SECTION_TOKENS as
+ *
+ *  	<D, |w_0|, ..., |w_{D-1}|, characters of w_0, ..., characters of w_{D-1}>
+ *
+ */
+
+#ifndef INTERNAL_WORD_TOKENIZER_HPP_
+#define INTERNAL_WORD_TOKENIZER_HPP_
+
+#include <algorithm>
+#include <istream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32c.hpp"
+
+using namespace std;
+
+template<typename itype = uint32_t>
+class word_tokenizer{
+
+public:
+
+	static const itype MAX_TOKENS = itype(1)<<15;
+
+	/*
+	 * tokenize the content of stream in. Return the sequence of token ids; the dictionary, the
+	 * CRC32C and the length of the text are stored in this object
+	 */
+	vector<itype> tokenize(istream & in){
+
+		string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+		text_length = text.size();
+		text_crc = crc32c::update(0,(const uint8_t*)text.data(),text.size());
+
+		//token boundaries
+		vector<uint64_t> start;
+
+		for(uint64_t i=0;i<text.size();++i){
+
+			if(i == 0 or is_word(text[i]) != is_word(text[i-1])) start.push_back(i);
+
+		}
+
+		start.push_back(text.size());
+
+		auto token = [&](uint64_t t){
+
+			return text.substr(start[t],start[t+1]-start[t]);
+
+		};
+
+		unordered_map<string,uint64_t> freq;
+
+		for(uint64_t t=0;t+1<start.size();++t) freq[token(t)]++;
+
+		//candidate tokens, by decreasing frequency
+		vector<pair<uint64_t,string> > candidates;
+
+		for(auto & e : freq){
+
+			if(e.second >= 2 and e.first.size() >= 2) candidates.push_back({e.second,e.first});
+
+		}
+
+		freq = {};
+
+		std::sort(candidates.begin(),candidates.end(),[](const pair<uint64_t,string> & a, const pair<uint64_t,string> & b){
+
+			return a.first > b.first or (a.first == b.first and a.second < b.second);
+
+		});
+
+		//256 ids are kept for single characters
+		if(candidates.size() > MAX_TOKENS-256) candidates.resize(MAX_TOKENS-256);
+
+		dictionary = {};
+		unordered_map<string,itype> id;
+
+		for(auto & c : candidates){
+
+			id[c.second] = dictionary.size();
+			dictionary.push_back(c.second);
+
+		}
+
+		candidates = {};
+
+		vector<itype> S;
+
+		auto emit = [&](const string & w){
+
+			auto it = id.find(w);
+
+			if(it == id.end()){
+
+				it = id.insert({w,itype(dictionary.size())}).first;
+				dictionary.push_back(w);
+
+			}
+
+			S.push_back(it->second);
+
+		};
+
+		for(uint64_t t=0;t+1<start.size();++t){
+
+			string w = token(t);
+
+			if(w.size() == 1 or id.count(w) == 1){
+
+				emit(w);
+
+			}else{
+
+				for(auto c : w) emit(string(1,c));
+
+			}
+
+		}
+
+		assert(dictionary.size() <= MAX_TOKENS);
+
+		return S;
+
+	}
+
+	/*
+	 * serialize the dictionary (payload of section RP_SECTION_TOKENS)
+	 */
+	vector<itype> dictionary_payload(){
+
+		vector<itype> payload = {itype(dictionary.size())};
+
+		for(auto & w : dictionary) payload.push_back(w.size());
+		for(auto & w : dictionary) for(auto c : w) payload.push_back(uint8_t(c));
+
+		return payload;
+
+	}
+
+	/*
+	 * read a dictionary from the payload of section RP_SECTION_TOKENS
+	 */
+	static vector<string> dictionary_from_payload(const vector<itype> & payload){
+
+		uint64_t D = payload[0];
+		uint64_t j = D+1; //next character
+
+		vector<string> dict(D);
+
+		for(uint64_t i=0;i<D;++i){
+
+			for(uint64_t l=0;l<payload[i+1];++l) dict[i].push_back(char(payload[j++]));
+
+		}
+
+		assert(j == payload.size());
+
+		return dict;
+
+	}
+
+	vector<string> dictionary;
+
+	uint32_t text_crc = 0;
+	uint64_t text_length = 0;
+
+private:
+
+	static bool is_word(char c){
+
+		uint8_t x = uint8_t(c);
+
+		return (x >= '0' and x <= '9') or (x >= 'a' and x <= 'z') or (x >= 'A' and x <= 'Z') or x == '_' or x >= 128;
+
+	}
+
+};
+
+#endif /* INTERNAL_WORD_TOKENIZER_HPP_ */
@@ -27,727 +27,1216 @@
 #include <set>
 #include <stack>
 
-#include <lf_queue.hpp>
-
-#include <ll_vec.hpp>
-#include <ll_el.hpp>
-
 #include <fstream>
 #include <cmath>
 
-#include "internal/hf_queue.hpp"
-#include "internal/skippable_text.hpp"
-#include "internal/text_positions.hpp"
+#include "internal/re_pair.hpp"
+#include "internal/sequitur.hpp"
+#include "internal/lz_grammar.hpp"
 #include "internal/packed_gamma_file3.hpp"
+#include "internal/rp_archive.hpp"
+#include "internal/grammar.hpp"
+#include "internal/crc32c.hpp"
+#include "internal/grammar_fingerprints.hpp"
+#include "internal/grammar_kgrams.hpp"
+#include "internal/grammar_index.hpp"
+#include "internal/succinct_grammar.hpp"
+#include <random>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include "internal/column_layout.hpp"
+#include "internal/word_tokenizer.hpp"
+#include "internal/utf8_tokenizer.hpp"
+#include "internal/fasta_layout.hpp"
+#include "internal/posting_lists.hpp"
 
 using namespace std;
 
 void help(){
 
 	cout << "Compressor and decompressor based on the Re-Pair grammar. Space usage: roughly 6n Bytes of RAM, where n < 2^32 is the file size." << endl << endl;
-	cout << "Usage: rp <c|d> <input> [output]" << endl;
+	cout << "Usage: rp c [-s <delimiter> | -w | -u | -n | -p] [-t <threads>] [-H <height>] [-r <ratio>] [-l] [-B] <input> [output]" << endl;
+	cout << "       rp c -S [-B] <input> [output]" << endl;
+	cout << "       rp c -z [-B] <input> [output]" << endl;
+	cout << "       rp d <input> [output]" << endl;
+	cout << "       rp check <archive>" << endl;
+	cout << "       rp cmp [-c] <archive1> <archive2>" << endl;
+	cout << "       rp slice <archive> <offset> <length> [-o output]" << endl;
+	cout << "       rp list <archive> <i> [x]" << endl;
+	cout << "       rp kgrams <archive> -k <K> [-top <N>] [kgram ...]" << endl;
+	cout << "       rp index <archive>" << endl;
+	cout << "       rp locate [-c] <archive> <pattern>" << endl;
+	cout << "       rp extract <archive> <offset> <length>" << endl;
 	cout << "   c         compress <input>" << endl;
+	cout << "   -s        split records (lines) into columns on <delimiter> (a character, or 'tab') and compress" << endl;
+	cout << "             each column with its own grammar, in parallel. Suited to CSV/TSV files" << endl;
+	cout << "   -w        split the text into word and separator tokens and compress the token sequence." << endl;
+	cout << "             Suited to natural-language text and logs" << endl;
+	cout << "   -u        UTF-8 mode: compress the sequence of code points (malformed bytes are kept as escapes)." << endl;
+	cout << "             Suited to CJK and other multi-byte text" << endl;
+	cout << "   -n        DNA mode for FASTA files: compress the nucleotides (ACGT) packed at 2 bits per base, and store" << endl;
+	cout << "             headers, line lengths, lower-case and non-ACGT runs separately" << endl;
+	cout << "   -p        posting-list mode: <input> has one sorted list of integers per line. Lists are gap-encoded" << endl;
+	cout << "             and compressed so that each of them can be decoded or searched on its own (see rp list)" << endl;
+	cout << "   -t        run the low-frequency phase on <threads> segments of the text in parallel, then merge them" << endl;
+	cout << "             (faster, but archives can be much larger: +15% on logs with 4 threads, +36% with 8). Not used" << endl;
+	cout << "             with -s, which compresses columns in parallel" << endl;
+	cout << "   -H        never create rules higher than <height> (faster random access, at some cost in compression)" << endl;
+	cout << "   -r        relaxed mode: synchronize the pair frequencies of a list of text positions only when at most" << endl;
+	cout << "             1/<ratio> of it is still up to date (default 2, exact Re-Pair): fewer synchronizations, larger archives" << endl;
+	cout << "   -l        long repeats: when all occurrences of a new rule are followed by the same symbols, create the" << endl;
+	cout << "             rules for the rest of the repeat in the same round. Fewer rounds on very repetitive inputs, but" << endl;
+	cout << "             most archives get larger (see README)" << endl;
+	cout << "   -B        choose the block size of the packed integers per section of the archive when that is smaller" << endl;
+	cout << "             (usually < 0.1% smaller). Versions of rp older than this option cannot read such archives" << endl;
+	cout << "   -S        online mode: build the grammar in one pass with Sequitur, in bounded memory (faster, larger" << endl;
+	cout << "             archives). The archive is read by all commands" << endl;
+	cout << "   -z        LZ77 front end for extremely repetitive inputs (e.g. versions of the same document): parse" << endl;
+	cout << "             the text into copies of earlier text and literals, and build a balanced grammar from the" << endl;
+	cout << "             parse. Much faster than Re-Pair when the text is made of long repeats" << endl;
 	cout << "   d         decompress <input>" << endl;
+	cout << "   check     verify the checksum of <archive> without decompressing it" << endl;
+	cout << "   cmp       find the first offset where the texts of two archives differ, without decompressing them" << endl;
+	cout << "   slice     store text[offset, offset+length-1] of <archive> in a new archive, without decompressing it." << endl;
+	cout << "             If -o is not specified, suffix .slice.rp is added to <archive>" << endl;
+	cout << "   list      print the i-th list of a posting-list archive (i starts from 0) or, if x is given, its" << endl;
+	cout << "             smallest element >= x" << endl;
+	cout << "   kgrams    print the N (default 20) most frequent substrings of length K of the text of <archive> or, if" << endl;
+	cout << "             k-grams are given, their frequencies. Computed on the grammar, without decompressing the archive" << endl;
+	cout << "   index     build the self-index of <archive> and store it to <archive>.idx" << endl;
+	cout << "   locate    print the text positions of all occurrences of <pattern> in <archive>, without decompressing it." << endl;
+	cout << "             Uses <archive>.idx if present (otherwise the index is built in memory)" << endl;
+	cout << "   extract   print text[offset, offset+length-1] of <archive> by random access on the grammar" << endl;
+	cout << "   -c        (cmp, locate) load the grammars in succinct form: less memory, slower queries" << endl;
 	cout << "   <input>   input text file (compression mode) or rp archive (decompression mode)" << endl;
 	cout << "   [output]  optional output file name. If not specified, suffix .rp is added (compression) or removed (decompression)" << endl;
 	exit(0);
 
 }
 
-//high/low frequency text type
-using text_t = skippable_text32_t;
-using TP_t = text_positions32_t;
-using hf_q_t = hf_queue32_t;
-using lf_q_t = lf_queue32_t;
+/*
+ * command-line number: decimal digits only, at most max. Calls help() otherwise
+ */
+uint64_t parse_number(string a, uint64_t max = ~uint64_t(0)){
+
+	//19 digits always fit in 64 bits
+	if(a.empty() or a.size() > 19 or a.find_first_not_of("0123456789") != string::npos) help();
+
+	uint64_t x = stoull(a);
+
+	if(x > max) help();
+
+	return x;
+
+}
+
+//use re_pair64_t and itype = uint64_t for files of size >= 2^32
+using re_pair_t = re_pair32_t;
 using itype = uint32_t;
 
 /*
-using text_t = skippable_text64_t;
-using TP_t = text_positions64_t;
-using hf_q_t = hf_queue64_t;
-using lf_q_t = lf_queue64_t;
-using itype = uint64_t;
-*/
+ * options of the Re-Pair engine (see re_pair.hpp) and of the archive writer set on the command line
+ */
+struct engine_options{
 
-using cpair = hf_q_t::cpair;
+	unsigned lf_threads = 1; //threads of the low-frequency phase
+	itype max_height = 0; //if > 0, maximum rule height
+	itype sync_ratio = 2; //synchronize a text position list when at most 1/sync_ratio of it is live
+	bool collapse_chains = false; //if true, create the rules of a long repeat in one round
+	bool per_stream = false; //if true, archives may use per-stream block sizes (see packed_gamma_file3.hpp)
 
-//next free dictionary symbol
-itype X=0;
-itype last_freq = 0;
-itype n_distinct_freqs = 0;
+	void apply(re_pair_t & RP) const{
 
-vector<itype> A; //alphabet (mapping int->ascii)
-vector<pair<itype, itype> > G; //grammar
-vector<itype> T_vec;// compressed text
+		RP.lf_threads = lf_threads;
+		RP.max_height = max_height;
+		RP.sync_ratio = sync_ratio;
+		RP.collapse_chains = collapse_chains;
+
+	}
+
+	void apply(rp_archive<itype> & arc) const{
+
+		arc.per_stream = per_stream;
+
+	}
+
+};
+
+void decompress(grammar<itype> & G, ofstream & ofs){
+
+	G.expand(ofs,0,G.text().size());
+
+}
 
 /*
- * Given (empty) queue, text positions, text, and minimum frequency: insert in Q all pairs with frequency at least min_freq.
- *
- * assumptions: TP is sorted by character pairs, Q is void
+ * compare the CRC32C and length stored in section tag of the archive with those of the text (crc, length).
  *
+ * returns false only if the archive stores a checksum and it does not match
  */
-void new_high_frequency_queue(hf_q_t & Q, TP_t & TP, text_t & T, uint64_t min_freq){
+bool check_integrity(rp_archive<itype> & arc, uint32_t crc, uint64_t length, itype tag = RP_SECTION_CRC32C){
 
-	itype j = 0; //current position on TP
-	itype n = TP.size();
+	if(not arc.has_section(tag)){
 
-	int old_perc = 0;
-	int perc;
+		cout << "The archive does not store a checksum." << endl;
+		return true;
 
-	itype n_pairs = 0;
+	}
 
-	/*
-	 * step 1: count number of high-freq pairs
-	 */
-	while(j<n){
+	auto & s = arc.section(tag);
 
-		itype k = 1; //current pair frequency
+	if(s.size() < 2 or s[0] != crc or s[1] != length){
 
-		while(	j<TP.size()-1 &&
-				T.pair_starting_at(TP[j]) != T.blank_pair() &&
-				T.pair_starting_at(TP[j]) == T.pair_starting_at(TP[j+1]) ){
+		cout << "Checksum mismatch: archive is corrupted." << endl;
+		return false;
 
-			j++;
-			k++;
+	}
 
-		}
+	cout << "Checksum OK (CRC32C = " << crc << ", " << length << " characters)." << endl;
+	return true;
+
+}
+
+/*
+ * compare the CRC32C stored in the archive with the one of the grammar's expansion. The latter
+ * is computed bottom-up on the rules, so this takes time proportional to the grammar size.
+ */
+bool check_integrity(rp_archive<itype> & arc, grammar<itype> & G){
 
-		if(k>=min_freq){
+	if(not arc.has_section(RP_SECTION_CRC32C)) return check_integrity(arc,0,0);
 
-			n_pairs++;
+	return check_integrity(arc,G.crc32c(),G.text_length());
 
-		}
+}
 
-		j++;
+/*
+ * the FASTA file of a FASTA archive is rebuilt (without writing it) to compute its checksum. Archives
+ * written by older versions store only the checksum of the nucleotides
+ */
+bool check_integrity(rp_archive<itype> & arc, grammar<itype> & G, fasta_layout<itype> & L){
+
+	if(not arc.has_section(RP_SECTION_FILE_CRC32C)){
+
+		cout << "Older FASTA archive: the checksum covers only the nucleotides." << endl;
+		return check_integrity(arc,G);
 
 	}
 
-	//largest possible dictionary symbol
-	itype max_d = 256+T.size()/min_freq;
+	auto c = L.crc32c(G);
 
-	//create new queue. Capacity is number of pairs / min_frequency
-	Q.init(max_d,min_freq);
+	return check_integrity(arc,c.first,c.second,RP_SECTION_FILE_CRC32C);
 
-	/*
-	 * step 2. Fill queue
-	 */
-	j = 0;
-	while(j<n){
+}
 
-		itype P_ab = j; //starting position in TP of pair
+/*
+ * the lists of a posting-list archive are decoded to compute their checksum
+ */
+bool check_integrity(rp_archive<itype> & arc, posting_lists<itype> & P){
 
-		itype k = 1; //current pair frequency
-		cpair ab = T.blank_pair();
+	if(not arc.has_section(RP_SECTION_CRC32C)) return check_integrity(arc,0,0);
 
-		while(	j<TP.size()-1 &&
-				T.pair_starting_at(TP[j]) != T.blank_pair() &&
-				T.pair_starting_at(TP[j]) == T.pair_starting_at(TP[j+1]) ){
+	auto c = P.crc32c();
 
-			ab = T.pair_starting_at(TP[j]);
+	return check_integrity(arc,c.first,c.second);
 
-			j++;
-			k++;
+}
 
-		}
+/*
+ * exit with an error if the text stored in archive arc is not the original file (its offsets are not
+ * file offsets): then what (e.g. "slicing") cannot work on the stored text
+ */
+void require_file_offsets(rp_archive<itype> & arc, string what){
+
+	if(arc.has_section(RP_SECTION_COLUMNS)){
+
+		cout << "Error: " << what << " is not supported on column archives (-s), which store the text column by column" << endl;
+		exit(1);
 
-		if(k>=min_freq){
+	}
+
+	if(arc.has_section(RP_SECTION_FASTA)){
+
+		cout << "Error: " << what << " is not supported on FASTA archives (-n), which store the nucleotides apart from the rest of the file" << endl;
+		exit(1);
+
+	}
+
+}
+
+/*
+ * compare the texts of two grammars in the compressed domain. The longest common prefix is found
+ * by binary search, comparing Karp-Rabin fingerprints of prefixes (one grammar descent per probe).
+ *
+ * returns true iff the two texts are equal
+ */
+template<typename grammar_t>
+bool compare_grammars(grammar_t & G1, grammar_t & G2, string in1, string in2){
+
+	//both grammars must use the same (random) base
+	std::random_device rd;
+	uint64_t base = ((uint64_t(rd()) << 32) | rd()) % (grammar_fingerprints<itype>::PRIME - 256) + 256;
 
-			Q.insert({ab, P_ab, k, k});
+	grammar_fingerprints<itype,grammar_t> KR1(&G1, base);
+	grammar_fingerprints<itype,grammar_t> KR2(&G2, base);
+
+	uint64_t n1 = G1.text_length();
+	uint64_t n2 = G2.text_length();
+
+	//invariant: prefixes of length lo are equal, prefixes of length > hi differ
+	uint64_t lo = 0;
+	uint64_t hi = std::min(n1,n2);
+	uint64_t probes = 0;
+
+	while(lo < hi){
+
+		uint64_t mid = lo + (hi-lo+1)/2;
+
+		probes++;
+
+		if(KR1.prefix(mid) == KR2.prefix(mid)){
+
+			lo = mid;
+
+		}else{
+
+			hi = mid-1;
 
 		}
 
-		j++;
+	}
+
+	cout << in1 << ": " << n1 << " characters" << endl;
+	cout << in2 << ": " << n2 << " characters" << endl;
+	cout << "Length difference = " << int64_t(n2) - int64_t(n1) << endl;
+	cout << "Number of prefix probes = " << probes << endl;
+
+	if(lo == n1 and lo == n2){
+
+		cout << "The archives contain the same text." << endl;
+		return true;
+
+	}
+
+	if(lo == std::min(n1,n2)){
+
+		cout << "The text of " << (n1 < n2 ? in1 : in2) << " is a prefix of the text of " << (n1 < n2 ? in2 : in1) << endl;
 
 	}
 
+	cout << "First difference at offset " << lo << endl;
+
+	return false;
+
 }
 
+/*
+ * compare the texts of archives in1 and in2 (see compare_grammars). If compact, the grammars
+ * are loaded in succinct form
+ */
+bool compare_archives(string in1, string in2, bool compact){
+
+	rp_archive<itype> arc1(in1);
+	rp_archive<itype> arc2(in2);
+
+	if(arc1.has_section(RP_SECTION_POSTINGS) or arc2.has_section(RP_SECTION_POSTINGS)){
+
+		cout << "Error: comparing posting-list archives is not supported" << endl;
+		exit(1);
+
+	}
+
+	require_file_offsets(arc1,"comparing");
+	require_file_offsets(arc2,"comparing");
+
+	if(compact){
+
+		succinct_grammar<itype> G1(arc1);
+		succinct_grammar<itype> G2(arc2);
+
+		return compare_grammars(G1,G2,in1,in2);
+
+	}
+
+	grammar<itype> G1(arc1);
+	grammar<itype> G2(arc2);
+
+	return compare_grammars(G1,G2,in1,in2);
+
+}
 
 /*
- * synchronize queue in range corresponding to pair AB.
+ * string k for printing: backslash escapes for '\\', '"', tab, newline and non-printable bytes
  */
-template<typename queue_t>
-void synchronize(queue_t & Q, TP_t & TP, text_t & T, cpair AB){
+string escape(const string & k){
+
+	string s;
+
+	for(auto c : k){
+
+		uint8_t x = uint8_t(c);
+
+		if(c == '\\' or c == '"'){
 
-	//variables associated with AB
-	assert(Q.contains(AB));
-	auto q_el = Q[AB];
-	itype P_AB = q_el.P_ab;
-	itype L_AB = q_el.L_ab;
-	itype F_AB = q_el.F_ab;
+			s.push_back('\\');
+			s.push_back(c);
 
-	itype freq_AB = 0;//number of pairs AB seen inside the interval. Computed inside this function
+		}else if(c == '\t'){
 
-	assert(P_AB+L_AB <= TP.size());
-	//sort sub-array corresponding to AB
-	TP.cluster(P_AB,P_AB+L_AB);
-	assert(TP.is_clustered(P_AB,P_AB+L_AB));
+			s.append("\\t");
 
-	//scan TP[P_AB,...,P_AB+L_AB-1] and detect new pairs
-	itype j = P_AB;//current position in TP
-	while(j<P_AB+L_AB){
+		}else if(c == '\n'){
 
-		itype p = j; //starting position of current pair in TP
-		itype k = 1; //current pair frequency
+			s.append("\\n");
 
-		cpair XY = T.pair_starting_at(TP[j]);
+		}else if(x < 32 or x >= 127){
 
-		while(	j<(P_AB+L_AB)-1 &&
-				XY != T.blank_pair() &&
-				XY == T.pair_starting_at(TP[j+1]) ){
+			char hex[5];
+			snprintf(hex,5,"\\x%02x",x);
+			s.append(hex);
 
-			j++;
-			k++;
+		}else{
+
+			s.push_back(c);
 
 		}
 
-		freq_AB = XY == AB ? k : freq_AB;
+	}
+
+	return s;
+
+}
+
+/*
+ * print k-gram frequencies of the text of archive in: the N most frequent k-grams or, if queries is
+ * not empty, the frequency of each query
+ */
+void kgram_statistics(string in, uint64_t k, uint64_t N, vector<string> & queries){
+
+	rp_archive<itype> arc(in);
+
+	if(arc.has_section(RP_SECTION_POSTINGS)){
+
+		cout << "Error: k-gram statistics are not supported on posting-list archives" << endl;
+		exit(1);
 
-		if(k >= Q.minimum_frequency()){
+	}
 
-			//if the pair is not AB and it is a high-frequency pair, insert it in queue
-			if(XY != AB){
+	require_file_offsets(arc,"k-gram counting");
 
-				assert(XY != T.blank_pair());
+	grammar<itype> G(arc);
 
-				assert(not Q.contains(XY));
+	grammar_kgrams<itype> K(&G,k);
 
-				Q.insert({XY,p,k,k});
+	cout << "Text length = " << G.text_length() << ", " << k << "-grams: " << K.total() << " (" << K.distinct() << " distinct)" << endl << endl;
 
-				assert(TP.contains_only(p,p+k,XY));
+	if(queries.size() > 0){
 
-			}else if(XY == AB){ //the pair is AB and is already in the queue: update its frequency
+		for(auto & q : queries){
 
-				assert(Q.contains(AB));
-				Q.update({AB,p,k,k});
+			if(q.size() != k){
 
-				assert(TP.contains_only(p,p+k,AB));
+				cout << "\"" << escape(q) << "\": not a " << k << "-gram" << endl;
+				continue;
 
 			}
 
+			cout << K.count(q) << "\t\"" << escape(q) << "\"" << endl;
+
 		}
 
-		j++;
+		return;
 
 	}
 
-	assert(Q.contains(AB));
+	for(auto & c : K.top(N)) cout << c.second << "\t\"" << escape(c.first) << "\"" << endl;
+
+}
 
-	//it could be that now AB's frequency is too small: delete it
-	if(freq_AB < Q.minimum_frequency()){
+/*
+ * build the self-index of archive in and store it to file in.idx
+ */
+void build_index(string in){
 
-		Q.remove(AB);
+	rp_archive<itype> arc(in);
+
+	if(arc.has_section(RP_SECTION_POSTINGS)){
+
+		cout << "Error: posting-list archives cannot be indexed (use rp list)" << endl;
+		exit(1);
 
 	}
 
-	assert(not Q.contains(AB) || Q[AB].F_ab == Q[AB].L_ab);
+	require_file_offsets(arc,"indexing");
+
+	grammar<itype> G(arc);
+	grammar_index<itype> I(&G);
+
+	cout << "Sorting " << I.number_of_boundaries() << " boundaries ... " << flush;
+	I.build();
+	cout << "done." << endl;
+
+	string out = in + ".idx";
+
+	I.store(out);
+
+	cout << "Index stored to " << out << endl;
 
 }
 
+/*
+ * print the positions of the occurrences of P in the text of G (archive in)
+ */
+template<typename grammar_t>
+void locate_in_grammar(grammar_t & G, string in, string P){
+
+	grammar_index<itype,grammar_t> I(&G);
+
+	if(not I.load(in + ".idx")){
+
+		cout << "No valid index found in " << in << ".idx: building it in memory (run rp index to store it)" << endl;
+		I.build();
+
+	}
+
+	auto occ = I.locate(P);
+
+	cout << occ.size() << " occurrences" << endl;
+
+	for(auto o : occ) cout << o << endl;
+
+}
 
 /*
- * look at F_ab and L_ab. Cases:
- *
- * 1. F_ab <= L_ab/2 and F_ab >= min_freq: synchronize pair. There could be new high-freq pairs in ab's list
- * 2. F_ab <= L_ab/2 and F_ab < min_freq: as above. This because there could be new high-freq pairs in ab's list.
- * 3. F_ab > L_ab/2 and F_ab >= min_freq: do nothing
- * 4. F_ab > L_ab/2 and F_ab < min_freq: remove ab. ab's list cannot contain high-freq pairs, so it is safe to lose references to these pairs.
- *
+ * print the positions of the occurrences of P in the text of archive in. If compact, the
+ * grammar is loaded in succinct form
  */
-template<typename queue_t>
-void synchro_or_remove_pair(queue_t & Q, TP_t & TP, text_t & T, cpair ab){
+void locate_pattern(string in, string P, bool compact){
 
-	assert(Q.contains(ab));
+	rp_archive<itype> arc(in);
 
-	auto q_el = Q[ab];
-	itype F_ab = q_el.F_ab;
-	itype L_ab = q_el.L_ab;
+	if(arc.has_section(RP_SECTION_POSTINGS)){
 
-	if(F_ab <= L_ab/2){
+		cout << "Error: posting-list archives cannot be indexed (use rp list)" << endl;
+		exit(1);
 
-		synchronize<queue_t>(Q, TP, T, ab);
+	}
 
-	}else{
+	require_file_offsets(arc,"locating");
 
-		if(F_ab < Q.minimum_frequency()){
+	if(compact){
 
-			Q.remove(ab);
+		succinct_grammar<itype> G(arc);
+		locate_in_grammar(G,in,P);
 
-		}
+	}else{
+
+		grammar<itype> G(arc);
+		locate_in_grammar(G,in,P);
 
 	}
 
 }
 
-
 /*
- * bit-width of x
+ * print text[offset, ..., offset+length-1] of archive in, by random access on the succinct grammar
  */
-uint64_t wd(uint64_t x){
+void extract_text(string in, uint64_t offset, uint64_t length){
 
-	auto w = 64 - __builtin_clzll(uint64_t(x));
+	rp_archive<itype> arc(in);
 
-	return x == 0 ? 1 : w;
+	if(arc.has_section(RP_SECTION_POSTINGS)){
 
-}
+		cout << "Error: random access on posting-list archives is not supported (use rp list)" << endl;
+		exit(1);
 
+	}
+
+	require_file_offsets(arc,"random access");
+
+	succinct_grammar<itype> G(arc);
 
-const pair<itype,itype> nullpair = {~itype(0),~itype(0)};
+	if(offset > G.text_length() or length > G.text_length() - offset){
+
+		cout << "Error: the text has only " << G.text_length() << " characters" << endl;
+		exit(1);
+
+	}
 
+	cout << G.extract(offset,length);
+
+}
 
 /*
- * return frequency of replaced pair
+ * build a standalone archive storing text[offset, ..., offset+length-1] of archive in.
+ *
+ * The symbols covering the range are extracted from Tc (splitting the boundary rules),
+ * then the rules reachable from them are collected and renumbered compactly.
  */
-template<typename queue_t>
-uint64_t substitution_round(queue_t & Q, TP_t & TP, text_t & T){
+void slice_archive(string in, uint64_t offset, uint64_t length, string out){
 
-	using ctype = text_t::char_type;
+	rp_archive<itype> arc(in);
 
-	//compute max
-	cpair AB = Q.max();
+	if(arc.has_section(RP_SECTION_TOKENS)){
 
-	G.push_back(AB);
+		cout << "Error: slicing token archives (-w, -u) is not supported (a range may split a token)" << endl;
+		exit(1);
 
-	//cout << "MAX freq = " << Q[AB].F_ab << endl;
+	}
 
-	assert(Q.contains(AB));
-	assert(Q[AB].F_ab >= Q.minimum_frequency());
+	if(arc.has_section(RP_SECTION_POSTINGS)){
 
-	//extract P_AB and L_AB
-	auto q_el = Q[AB];
-	itype F_AB = q_el.F_ab;
-	itype P_AB = q_el.P_ab;
-	itype L_AB = q_el.L_ab;
+		cout << "Error: slicing posting-list archives is not supported (use rp list)" << endl;
+		exit(1);
 
-	uint64_t f_replaced = F_AB;
+	}
 
-	n_distinct_freqs += (F_AB != last_freq);
-	last_freq = F_AB;
+	require_file_offsets(arc,"slicing");
 
-	for(itype j = P_AB; j<P_AB+L_AB;++j){
+	grammar<itype> G(arc);
 
-		itype i = TP[j];
+	if(length == 0 or offset+length > G.text_length()){
 
-		if(T.pair_starting_at(i) == AB){
+		cout << "Error: range [" << offset << ", " << offset+length << ") is not inside the text (length " << G.text_length() << ")" << endl;
+		exit(1);
 
-			ctype A = AB.first;
-			ctype B = AB.second;
+	}
 
-			//the context of AB is xABy. We now extract AB's context:
-			cpair xA = T.pair_ending_at(i);
-			cpair By = T.next_pair(i);
+	auto C = G.cover(offset,length);
 
-			assert(xA == T.blank_pair() or xA.second == A);
-			assert(By == T.blank_pair() or By.first == B);
+	//collect symbols reachable from the cover
+	vector<itype> symbols;
+	unordered_map<itype,itype> new_id;
 
-			//note: xA and By could be blank pairs if this AB was the first/last pair in the text
+	{
+		std::stack<itype> S;
+		for(auto X : C) S.push(X);
+
+		while(not S.empty()){
+
+			itype X = S.top();
+			S.pop();
 
-			//perform replacement
-			T.replace(i,X);
+			if(new_id.count(X)) continue;
 
-			assert(By == T.blank_pair() || T.pair_starting_at(i) == cpair(X,By.second));
+			new_id[X] = 0;
+			symbols.push_back(X);
 
-			if(Q.contains(xA) && xA != AB){
+			if(not G.is_terminal(X)){
 
-				Q.decrease(xA);
+				auto ab = G.rule(X);
+				S.push(ab.first);
+				S.push(ab.second);
 
 			}
 
-			if(Q.contains(By) && By != AB){
+		}
+	}
 
-				Q.decrease(By);
+	//children are smaller than parents, so sorting preserves the bottom-up order of the rules
+	std::sort(symbols.begin(),symbols.end());
 
-			}
+	for(itype i=0;i<symbols.size();++i) new_id[symbols[i]] = i;
+
+	rp_archive<itype> slice;
+
+	for(auto X : symbols){
+
+		if(G.is_terminal(X)){
+
+			slice.A.push_back(G.terminal(X));
+
+		}else{
+
+			auto ab = G.rule(X);
+			slice.G.push_back({new_id[ab.first],new_id[ab.second]});
 
 		}
 
 	}
 
-	/*
-	 * re-scan text positions associated to AB and synchronize if needed
-	 */
-	for(itype j = P_AB; j<P_AB+L_AB;++j){
+	for(auto X : C) slice.T.push_back(new_id[X]);
 
-		itype i = TP[j];
+	cout << "Slice [" << offset << ", " << offset+length << "): " << C.size() << " symbols in the compressed text, ";
+	cout << slice.G.size() << " rules (out of " << G.number_of_rules() << ")" << endl << endl;
 
-		assert(T.pair_starting_at(i) != AB); //we replaced all ABs ...
+	{
+		auto A_copy = slice.A;
+		auto G_copy = slice.G;
+		auto T_copy = slice.T;
 
-		if(T[i] == X){
+		grammar<itype> S(A_copy,G_copy,T_copy);
 
-			//the context of X is xXy. We now extract X's left (x) and right (y) contexts:
-			cpair xX = T.pair_ending_at(i);
-			cpair Xy = T.pair_starting_at(i);
+		assert(S.text_length() == length);
 
-			ctype A = AB.first;
-			ctype B = AB.second;
+		slice.set_section(RP_SECTION_CRC32C, {S.crc32c(), itype(length)});
+	}
 
-			//careful: x and y could be = X. in this case, before the replacements this xX was equal to ABAB -> a BA disappeared
-			ctype x = xX.first == X ? B : xX.first;
-			ctype y = Xy.second == X ? A : Xy.second;
+	slice.store(out);
 
-			//these are the pairs that disappeared
-			cpair xA = xX == T.blank_pair() ? xX : cpair {x,A};
-			cpair By = Xy == T.blank_pair() ? Xy : cpair {B,y};
+}
 
-			if(Q.contains(By) && By != AB){
+/*
+ * split file in into word and separator tokens, compress the token sequence and store the archive
+ * (including the token dictionary) to file out
+ */
+void compress_words(string in, string out, const engine_options & opt){
 
-				synchro_or_remove_pair<queue_t>(Q, TP, T, By);
+	word_tokenizer<itype> W;
+	vector<itype> S;
 
-			}
+	{
+		ifstream ifs(in);
+		S = W.tokenize(ifs);
+	}
 
-			if(Q.contains(xA) && xA != AB){
+	cout << "Text split into " << S.size() << " tokens (" << W.dictionary.size() << " distinct)" << endl;
 
-				synchro_or_remove_pair<queue_t>(Q, TP, T, xA);
+	re_pair_t RP;
+	opt.apply(RP);
+	RP.compress_symbols(S);
 
-			}
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
 
-		}
+	rp_archive<itype> out_file;
+	out_file.A.swap(RP.A);
+	out_file.G.swap(RP.G);
+	out_file.T.swap(RP.T_vec);
+	out_file.set_section(RP_SECTION_CRC32C, {W.text_crc, itype(W.text_length)});
+	out_file.set_section(RP_SECTION_TOKENS, W.dictionary_payload());
+
+	opt.apply(out_file);
+	out_file.store(out);
+
+}
+
+/*
+ * split UTF-8 file in into code points, compress the code point sequence and store the archive
+ * (including the code point dictionary) to file out
+ */
+void compress_utf8(string in, string out, const engine_options & opt){
+
+	utf8_tokenizer<itype> U;
+	vector<itype> S;
 
+	{
+		ifstream ifs(in);
+		S = U.tokenize(ifs);
 	}
 
-	assert(Q.contains(AB));
-	synchronize<queue_t>(Q, TP, T, AB); //automatically removes AB since new AB's frequency is 0
-	assert(not Q.contains(AB));
+	cout << "Text split into " << S.size() << " code points (" << U.code_points << " distinct multi-byte code points, " << U.escapes << " malformed bytes)" << endl;
 
-	//advance next free dictionary symbol
-	X++;
+	re_pair_t RP;
+	opt.apply(RP);
+	RP.compress_symbols(S);
 
-	//cout << " current text size = " << T.number_of_non_blank_characters() << endl << endl;
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
+
+	rp_archive<itype> out_file;
+	out_file.A.swap(RP.A);
+	out_file.G.swap(RP.G);
+	out_file.T.swap(RP.T_vec);
+	out_file.set_section(RP_SECTION_CRC32C, {U.text_crc, itype(U.text_length)});
+	out_file.set_section(RP_SECTION_TOKENS, U.dictionary_payload());
 
-	return f_replaced;
+	opt.apply(out_file);
+	out_file.store(out);
 
 }
 
+/*
+ * compress the nucleotides of FASTA file in and store the archive (including the side streams) to file out
+ */
+void compress_dna(string in, string out, const engine_options & opt){
+
+	fasta_layout<itype> L;
+	packed_dna<itype> P;
+
+	{
+		ifstream ifs(in);
+		P = L.split(ifs);
+	}
+
+	itype n = P.size();
 
-void compute_repair(string in){
+	cout << "Nucleotides: " << n << " (" << L.number_of_headers() << " headers, " << L.number_of_exceptions() << " runs of other residues)" << endl;
 
+	//pair frequencies are counted on the packed words
+	auto H = P.pair_histogram();
 
-	//packed_gamma_file2<> out_file(out);
-	//packed_gamma_file2<> out_file(out);
+	re_pair_t RP;
+	opt.apply(RP);
+	RP.compress_symbols(P,H);
 
-	/*
-	 * tradeoff between low-frequency and high-freq phase:
-	 *
-	 * - High-freq phase will use n^(2 - 2*alpha) words of memory and process approximately n^(1-alpha) pairs
-	 *   alpha should satisfy 0.5 < alpha < 1
-	 *
-	 * - Low-freq phase will use n^alpha words of memory
-	 *
-	 */
-	double alpha = 0.66; // = 2/3
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
 
-	/*
-	 * in the low-frequency pair processing phase, insert at most n/B elements in the hash
-	 */
-	uint64_t B = 50;
+	rp_archive<itype> out_file;
 
-	itype n;
-	itype sigma = 0; //alphabet size
+	for(auto x : RP.A) out_file.A.push_back(fasta_layout<itype>::base(x));
 
-	/*
-	 * Pairs with frequency greater than or equal to min_high_frequency are inserted in high-freq queue
-	 */
-	itype min_high_frequency = 0;
-	itype lf_queue_capacity = 0;
+	out_file.G.swap(RP.G);
+	out_file.T.swap(RP.T_vec);
+	//the checksum of the nucleotides is the one verified by versions without RP_SECTION_FILE_CRC32C
+	out_file.set_section(RP_SECTION_CRC32C, {L.bases_crc, n});
+	out_file.set_section(RP_SECTION_FILE_CRC32C, {L.text_crc, itype(L.text_length)});
+	out_file.set_section(RP_SECTION_FASTA, L.serialize());
 
-	/*
-	 * (1) INITIALIZE DATA STRUCTURES
-	 */
+	opt.apply(out_file);
+	out_file.store(out);
 
-	const itype null = ~itype(0);
+}
 
-	ifstream ifs(in);
+/*
+ * compress the sorted integer lists of file in (one per line) and store the archive to file out.
+ * The list terminator is never paired, so every list can be decoded on its own
+ */
+void compress_postings(string in, string out, const engine_options & opt){
 
-	vector<itype> char_to_int(256,null);
+	posting_lists<itype> P;
+	vector<itype> S;
 
-	//count file size
 	{
-		ifstream file(in,ios::ate);
-		n = file.tellg();
+		ifstream ifs(in);
+		S = P.encode(ifs);
 	}
 
-	min_high_frequency = std::pow(  n, alpha  );// n^(alpha)
+	cout << "Number of lists = " << P.number_of_lists() << " (" << S.size() << " symbols)" << endl;
 
-	min_high_frequency = min_high_frequency <2 ? 2 : min_high_frequency;
+	re_pair_t RP;
+	opt.apply(RP);
+	RP.separator = posting_lists<itype>::TERMINATOR;
+	RP.compress_symbols(S);
 
-	cout << "File size = " << n << " characters"  << endl;
-	cout << "cut-off frequency = " << min_high_frequency  << endl;
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
 
-	itype width = 64 - __builtin_clzll(uint64_t(n));
+	rp_archive<itype> out_file;
+	out_file.A.swap(RP.A);
+	out_file.G.swap(RP.G);
+	out_file.T.swap(RP.T_vec);
+	out_file.set_section(RP_SECTION_CRC32C, {P.text_crc, itype(P.text_length)});
+	out_file.set_section(RP_SECTION_POSTINGS, P.serialize());
 
-	//largest possible high-frequency dictionary symbol
-	//at most max_d <= n high-freq dictionary symbols can be created; given that min. freq of
-	//a high-freq dictionary symbol is f=min_high_frequency and that every new dictionary symbol
-	//introduces a blank in the text, we have the inequality max_d * f <= n  <=> max_d <= n/f
-	itype max_d = 256+n/min_high_frequency;
+	opt.apply(out_file);
+	out_file.store(out);
 
-	//cout << "Max high-frequency dictionary symbol = " << max_d << endl << endl;
+}
 
-	//initialize text and text positions
-	text_t T(n);
+/*
+ * compress file in in one pass with the online engine (see sequitur.hpp) and store the archive to file out
+ */
+void compress_online(string in, string out, const engine_options & opt){
 
-	itype j = 0;
+	sequitur<itype> S;
 
-	cout << "filling skippable text with text characters ... " << flush;
+	{
+		ifstream ifs(in);
+		S.compress(ifs);
+	}
 
-	char c;
+	cout << "Text of " << S.text_length << " characters parsed in one pass (" << S.number_of_blocks() << " blocks)" << endl;
 
-	while(ifs.get(c)){
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
 
-		if(char_to_int[uint8_t(c)] == null){
+	rp_archive<itype> out_file;
+	out_file.A.swap(S.A);
+	out_file.G.swap(S.G);
+	out_file.T.swap(S.T_vec);
+	out_file.set_section(RP_SECTION_CRC32C, {S.text_crc, itype(S.text_length)});
 
-			char_to_int[uint8_t(c)] = sigma;
-			A.push_back(uint8_t(c));
-			sigma++;
+	opt.apply(out_file);
+	out_file.store(out);
 
-		}
+}
+
+/*
+ * compress file in with the LZ77 front end (see lz_grammar.hpp) and store the archive to file out
+ */
+void compress_lz(string in, string out, const engine_options & opt){
 
-		T.set(j++,char_to_int[uint8_t(c)]);
+	lz_grammar<itype> Z;
 
+	{
+		ifstream ifs(in);
+		Z.compress(ifs);
 	}
 
-	cout << "done. " << endl << endl;
+	cout << "Text of " << Z.text_length << " characters parsed into " << Z.number_of_copies() << " copies and " << Z.number_of_literals() << " literals (" << Z.number_of_pieces() << " symbols)" << endl;
 
-	cout << "alphabet size is " << sigma  << endl << endl;
+	cout << "Compressing grammar and storing it to file ... " << endl << endl;
 
-	cout << "initializing and sorting text positions vector ... " << flush;
+	rp_archive<itype> out_file;
+	out_file.A.swap(Z.A);
+	out_file.G.swap(Z.G);
+	out_file.T.swap(Z.T_vec);
+	out_file.set_section(RP_SECTION_CRC32C, {Z.text_crc, itype(Z.text_length)});
 
-	TP_t TP(&T,min_high_frequency);
+	opt.apply(out_file);
+	out_file.store(out);
 
-	cout << "done. Number of text positions containing a high-frequency pair: " << TP.size() << endl;
+}
 
-	//next free dictionary symbol = sigma
-	X =  sigma;
+/*
+ * print the i-th list of posting-list archive in or, if x != none, its smallest element >= x
+ */
+void query_list(string in, uint64_t i, uint64_t x){
 
-	cout << "\nSTEP 1. HIGH FREQUENCY PAIRS" << endl << endl;
+	rp_archive<itype> arc(in);
 
-	cout << "inserting pairs in high-frequency queue ... " << flush;
+	if(not arc.has_section(RP_SECTION_POSTINGS)){
 
-	hf_q_t HFQ;
-	new_high_frequency_queue(HFQ, TP, T, min_high_frequency);
+		cout << "Error: " << in << " is not a posting-list archive" << endl;
+		exit(1);
 
-	cout << "done. Number of distinct high-frequency pairs = " << HFQ.size() << endl;
+	}
+
+	posting_lists<itype> P(arc);
 
-	cout << "Replacing high-frequency pairs ... " << endl;
+	if(i >= P.number_of_lists()){
 
-	int last_perc = -1;
-	uint64_t F = 0;//largest freq
+		cout << "Error: list " << i << " does not exist (the archive stores " << P.number_of_lists() << " lists)" << endl;
+		exit(1);
 
-	while(HFQ.max() != HFQ.nullpair()){
+	}
 
-		auto f = substitution_round<hf_q_t>(HFQ, TP, T);
+	if(x != posting_lists<itype>::none){
 
-		if(last_perc == -1){
+		uint64_t y = P.next_geq(i,x);
 
-			F = f;
+		if(y == posting_lists<itype>::none){
 
-			last_perc = 0;
+			cout << "none" << endl;
 
 		}else{
 
-			int perc = 100-(100*f)/F;
+			cout << y << endl;
+
+		}
+
+		return;
+
+	}
+
+	auto L = P.decode_list(i);
+
+	for(uint64_t k=0;k<L.size();++k) cout << (k > 0 ? " " : "") << L[k];
+	cout << endl;
+
+}
+
+/*
+ * split the records of file in into columns on the delimiter, compress the columns in parallel and
+ * merge their grammars into a single archive
+ */
+void compress_columns(string in, char delimiter, string out, const engine_options & opt){
+
+	column_layout<itype> L;
+	vector<string> columns;
+
+	{
+		ifstream ifs(in);
+		columns = L.split(ifs,delimiter);
+	}
+
+	cout << "Number of records = " << L.number_of_records() << endl;
+	cout << "Number of columns = " << columns.size() << endl << endl;
+
+	//one (quiet) compressor per column
+	deque<re_pair_t> E;
+	for(uint64_t c=0;c<columns.size();++c) E.emplace_back(false);
+
+	//columns are already compressed in parallel: the low-frequency phase of each runs on one thread
+	engine_options column_opt = opt;
+	column_opt.lf_threads = 1;
+
+	for(auto & e : E) column_opt.apply(e);
 
-			if(perc > last_perc+4){
+	//compress columns in parallel
+	{
+		std::atomic<uint64_t> next_column(0);
+
+		auto worker = [&](){
+
+			uint64_t c;
 
-				last_perc = perc;
-				cout << perc << "%" << endl;
+			while((c = next_column++) < columns.size()){
+
+				istringstream iss(columns[c]);
+				E[c].compress(iss, columns[c].size());
+
+				columns[c] = string();
 
 			}
 
-		}
+		};
 
+		uint64_t n_threads = std::max(1u,std::thread::hardware_concurrency());
+		n_threads = std::min(n_threads,uint64_t(columns.size()));
+
+		vector<std::thread> threads;
+		for(uint64_t t=0;t<n_threads;++t) threads.push_back(std::thread(worker));
+		for(auto & t : threads) t.join();
 	}
 
-	cout << "done. " << endl;
-	cout << "Peak queue size = " << HFQ.peak() << " (" << double(HFQ.peak())/double(n) << "n)" << endl;
+	for(uint64_t c=0;c<E.size();++c){
 
-	cout << "\nSTEP 2. LOW FREQUENCY PAIRS" << endl << endl;
+		cout << "column " << c << ": " << E[c].text_length << " characters, " << E[c].G.size() << " rules, ";
+		cout << E[c].T_vec.size() << " symbols in the compressed text" << endl;
 
-	cout << "Re-computing TP array ... " << flush;
+	}
 
-	//T.compact(); //remove blank positions
-	TP.fill_with_text_positions(); //store here all remaining text positions
+	cout << endl << "Compressing grammar and storing it to file ... " << endl << endl;
 
-	cout << "done." << endl;
+	rp_archive<itype> out_file;
+	L.merge(E,out_file);
 
-	cout << "Sorting  TP array ... " << flush;
-	TP.cluster(); //cluster text positions by character pairs
-	cout << "done." << endl;
+	opt.apply(out_file);
+	out_file.store(out);
 
+}
 
-	cout << "Counting low-frequency pairs ... " << flush;
-	/*
-	 * scan sorted array of text positions and count frequencies
-	 *
-	 * in this phase, all pairs have frequency < min_high_frequency
-	 *
-	 * after counting, frequencies[f] is the number of pairs with frequency equal to f
-	 *
-	 */
-	//auto frequencies = vector<uint64_t>(min_high_frequency,0);
-	uint64_t n_lf_pairs = 0; //number of low-frequency pairs
+int main(int argc,char** argv) {
 
-	uint64_t f = 1;
-	for(uint64_t i=1;i<TP.size();++i){
+	if(argc < 3) help();
 
-		if(T.pair_starting_at(TP[i]) == T.pair_starting_at(TP[i-1])){
+	string mode(argv[1]);
 
-			f++;
+	if(mode.compare("slice")==0){
 
-		}else{
+		if((argc != 5 and argc != 7) or not ifstream(argv[2]).good()) help();
+
+		uint64_t offset = parse_number(argv[3]);
+		uint64_t length = parse_number(argv[4]);
 
-			f=1;
-			n_lf_pairs++;
+		string out = string(argv[2]).append(".slice.rp");
+
+		if(argc == 7){
+
+			if(string(argv[5]).compare("-o") != 0) help();
+			out = argv[6];
 
 		}
 
+		cout << "Slicing archive " << argv[2] << endl;
+		cout << "Output will be saved to " << out << endl << endl;
+
+		slice_archive(argv[2], offset, length, out);
+
+		return 0;
+
 	}
-	cout << "done. Number of distict low-frequency pairs: "<< n_lf_pairs << endl;
 
-	cout << "Filling low-frequency queue ... " << flush;
+	if(mode.compare("list")==0){
 
-	lf_q_t LFQ(min_high_frequency-1);
+		if((argc != 4 and argc != 5) or not ifstream(argv[2]).good()) help();
 
-	f = 1;
+		query_list(argv[2], parse_number(argv[3]), argc == 5 ? parse_number(argv[4]) : posting_lists<itype>::none);
 
-	using el_t = lf_q_t::el_type;
+		return 0;
 
-	for(uint64_t i=1;i<TP.size();++i){
+	}
 
-		if(T.pair_starting_at(TP[i]) == T.pair_starting_at(TP[i-1])){
+	if(mode.compare("index")==0){
 
-			f++;
+		if(argc != 3 or not ifstream(argv[2]).good()) help();
 
-		}else{
+		build_index(argv[2]);
 
-			if(f>1){
+		return 0;
 
-				cpair ab = T.pair_starting_at(TP[i-1]);
+	}
 
-				assert(i>=f);
-				itype P_ab = i - f;
+	if(mode.compare("locate")==0){
 
-				itype L_ab = f;
+		bool compact = argc == 5 and string(argv[2]).compare("-c")==0;
+		int a = compact ? 3 : 2;
 
-				itype F_ab = f;
+		if(argc != a+2 or not ifstream(argv[a]).good()) help();
 
-				el_t el = {ab,P_ab,L_ab,F_ab};
+		locate_pattern(argv[a], argv[a+1], compact);
 
-				LFQ.insert(el);
+		return 0;
 
-			}
+	}
+
+	if(mode.compare("extract")==0){
+
+		if(argc != 5 or not ifstream(argv[2]).good()) help();
+
+		extract_text(argv[2], parse_number(argv[3]), parse_number(argv[4]));
+
+		return 0;
+
+	}
+
+	if(mode.compare("kgrams")==0){
+
+		uint64_t k = 0;
+		uint64_t N = 20;
+		vector<string> queries;
+
+		for(int i=3;i<argc;++i){
+
+			string a(argv[i]);
 
-			f=1;
+			if(a.compare("-k")==0 and i+1<argc){
+
+				k = parse_number(argv[++i]);
+
+			}else if(a.compare("-top")==0 and i+1<argc){
+
+				N = parse_number(argv[++i]);
+
+			}else{
+
+				queries.push_back(a);
+
+			}
 
 		}
 
+		if(k == 0 or not ifstream(argv[2]).good()) help();
+
+		kgram_statistics(argv[2], k, N, queries);
+
+		return 0;
+
 	}
 
-	cout << "done." << endl;
+	if(mode.compare("check")==0){
 
-	cout << "Replacing low-frequency pairs ... " << endl;
+		if(argc != 3 or not ifstream(argv[2]).good()) help();
 
-	pair<itype,itype> replaced = {0,0};
+		cout << "Checking archive " << argv[2] << endl;
 
-	last_perc = -1;
-	uint64_t tl = T.number_of_non_blank_characters();
+		rp_archive<itype> arc(argv[2]);
 
-	while(LFQ.max() != LFQ.nullpair()){
+		if(arc.has_section(RP_SECTION_POSTINGS)){
 
-		auto f = substitution_round<lf_q_t>(LFQ, TP, T);
+			posting_lists<itype> P(arc);
+			return check_integrity(arc,P) ? 0 : 1;
 
-		int perc = 100-(100*T.number_of_non_blank_characters())/tl;
+		}
 
-		if(perc>last_perc+4){
+		grammar<itype> G(arc);
 
-			last_perc = perc;
+		if(arc.has_section(RP_SECTION_FASTA)){
 
-			cout << perc << "%" << endl;
+			fasta_layout<itype> L(arc.section(RP_SECTION_FASTA));
+			return check_integrity(arc,G,L) ? 0 : 1;
 
 		}
 
+		return check_integrity(arc,G) ? 0 : 1;
+
 	}
 
-	cout << "done. " << endl;
-	cout << "Peak queue size = " << LFQ.peak() << " (" << double(LFQ.peak())/double(n) << "n)" << endl;
+	if(mode.compare("cmp")==0){
 
-	cout << "Compressing grammar and storing it to file ... " << endl << endl;
+		bool compact = argc == 5 and string(argv[2]).compare("-c")==0;
+		int a = compact ? 3 : 2;
 
-	for(itype i=0;i<T.size();++i){
+		if(argc != a+2 or not ifstream(argv[a]).good() or not ifstream(argv[a+1]).good()) help();
 
-		if(not T.is_blank(i)) T_vec.push_back(T[i]);
+		return compare_archives(argv[a],argv[a+1],compact) ? 0 : 1;
 
 	}
 
-}
+	char delimiter = 0; //if != 0, split records into columns on this delimiter
+	bool words = false; //if true, compress the sequence of word tokens
+	bool utf8 = false; //if true, compress the sequence of UTF-8 code points
+	bool dna = false; //if true, compress the nucleotides of a FASTA file
+	bool postings = false; //if true, compress a set of sorted integer lists
+	bool online = false; //if true, use the online engine instead of Re-Pair
+	bool lz = false; //if true, use the LZ77 front end
+	engine_options opt; //options of the Re-Pair engine
 
-void decompress(vector<itype> & A, vector<pair<itype,itype> > & G, vector<itype> & Tc, ofstream & ofs){
+	vector<string> args; //input and output file names
 
-	std::stack<itype> S;
+	for(int i=2;i<argc;++i){
 
-	string buffer;
-	int buf_size = 1000000;//1 MB buffer
+		string a(argv[i]);
 
-	/*
-	 * decompress Tc symbols one by one
-	 */
-	for(itype i = 0;i<Tc.size();++i){
+		if(mode.compare("c")==0 and a.compare("-s")==0 and i+1<argc){
 
-		S.push(Tc[i]);
+			string d(argv[++i]);
 
-		while(!S.empty()){
+			if(d.compare("tab")==0 or d.compare("\\t")==0) d = "\t";
+			if(d.size() != 1 or d[0] == '\n') help();
 
-			itype X = S.top(); //get symbol
-			S.pop();//remove top
+			delimiter = d[0];
 
-			if(X<A.size()){
+		}else if(mode.compare("c")==0 and a.compare("-w")==0){
 
-				char c = A[X];
+			words = true;
 
-				buffer.push_back(c);
+		}else if(mode.compare("c")==0 and a.compare("-u")==0){
 
-				if(buffer.size()==buf_size){
+			utf8 = true;
 
-					ofs.write(buffer.c_str(),buffer.size());
-					buffer = string();
+		}else if(mode.compare("c")==0 and a.compare("-n")==0){
 
-				}
+			dna = true;
 
-			}else{
+		}else if(mode.compare("c")==0 and a.compare("-t")==0 and i+1<argc){
 
-				//expand rule: X -> ab
-				auto ab = G[X-A.size()];
+			opt.lf_threads = parse_number(argv[++i],1024);
+			if(opt.lf_threads == 0) help();
 
-				S.push(ab.second);
-				S.push(ab.first);
+		}else if(mode.compare("c")==0 and a.compare("-H")==0 and i+1<argc){
 
-			}
+			opt.max_height = parse_number(argv[++i],~itype(0));
+			if(opt.max_height == 0) help();
 
-		}
+		}else if(mode.compare("c")==0 and a.compare("-r")==0 and i+1<argc){
 
-	}
+			opt.sync_ratio = parse_number(argv[++i],64);
+			if(opt.sync_ratio < 2) help();
 
-	if(buffer.size()>0) ofs.write(buffer.c_str(),buffer.size());
+		}else if(mode.compare("c")==0 and a.compare("-l")==0){
 
-}
+			opt.collapse_chains = true;
 
-int main(int argc,char** argv) {
+		}else if(mode.compare("c")==0 and a.compare("-B")==0){
 
-	if(argc!=3 and argc != 4) help();
+			opt.per_stream = true;
 
-	string mode(argv[1]);
+		}else if(mode.compare("c")==0 and a.compare("-p")==0){
+
+			postings = true;
+
+		}else if(mode.compare("c")==0 and a.compare("-S")==0){
+
+			online = true;
+
+		}else if(mode.compare("c")==0 and a.compare("-z")==0){
+
+			lz = true;
+
+		}else{
+
+			args.push_back(a);
+
+		}
 
-	string in(argv[2]);
+	}
+
+	if(args.size() != 1 and args.size() != 2) help();
+	if(int(words) + int(utf8) + int(dna) + int(postings) + int(delimiter != 0) + int(online) + int(lz) > 1) help();
+	if((online or lz) and (opt.lf_threads > 1 or opt.max_height > 0 or opt.sync_ratio != 2 or opt.collapse_chains)) help();
+
+	string in(args[0]);
 	string out;
 
-	if(argc == 4){
+	if(args.size() == 2){
 
 		//use output name provided by user
-		out = string(argv[3]);
+		out = args[1];
 
 	}else{
 
-		out = string(argv[2]);
+		out = args[0];
 
 		if(mode.compare("c")==0){
 
@@ -793,30 +1282,133 @@ int main(int argc,char** argv) {
 		cout << "Compressing file " << in << endl;
 		cout << "Output will be saved to file " << out << endl<<endl;
 
-		compute_repair(in);
+		if(delimiter != 0){
+
+			compress_columns(in, delimiter, out, opt);
+			return 0;
+
+		}
+
+		if(words){
+
+			compress_words(in, out, opt);
+			return 0;
+
+		}
+
+		if(utf8){
+
+			compress_utf8(in, out, opt);
+			return 0;
+
+		}
+
+		if(dna){
+
+			compress_dna(in, out, opt);
+			return 0;
+
+		}
+
+		if(postings){
+
+			compress_postings(in, out, opt);
+			return 0;
+
+		}
+
+		if(online){
+
+			compress_online(in, out, opt);
+			return 0;
+
+		}
+
+		if(lz){
+
+			compress_lz(in, out, opt);
+			return 0;
+
+		}
+
+		re_pair_t RP;
+		opt.apply(RP);
+		RP.compress(in);
+
+		cout << "Compressing grammar and storing it to file ... " << endl << endl;
+
+		rp_archive<itype> out_file;
+		out_file.A.swap(RP.A);
+		out_file.G.swap(RP.G);
+		out_file.T.swap(RP.T_vec);
+		out_file.set_section(RP_SECTION_CRC32C, {RP.text_crc, RP.text_length});
 
-		packed_gamma_file3<> out_file(out);
 		//compress the grammar with Elias' gamma-encoding and store it to file
-		out_file.compress_and_store(A,G,T_vec);
+		opt.apply(out_file);
+		out_file.store(out);
 
 	}else{
 
 		cout << "Decompressing archive " << in << endl;
 		cout << "Output will be saved to " << out << endl;
 
-		auto pgf = packed_gamma_file3<>(in, false);
+		//read and decompress grammar (the DAG)
+		rp_archive<itype> arc(in);
+
+		if(arc.has_section(RP_SECTION_POSTINGS)){
 
-		vector<itype> A;
-		vector<pair<itype,itype> > G;
-		vector<itype> Tc;
+			//decode the lists one by one
+			posting_lists<itype> P(arc);
 
-		//read and decompress grammar (the DAG)
-		pgf.read_and_decompress(A,G,Tc);
+			if(not check_integrity(arc,P)) return 1;
+
+			ofstream ofs(out);
+			P.expand(ofs);
+			ofs.close();
+
+			cout << "done." << endl;
+
+			return 0;
+
+		}
+
+		grammar<itype> G(arc);
+
+		if(arc.has_section(RP_SECTION_FASTA)){
+
+			fasta_layout<itype> L(arc.section(RP_SECTION_FASTA));
+
+			//verify the checksum of the FASTA file before writing it
+			if(not check_integrity(arc,G,L)) return 1;
+
+			//merge nucleotides and side streams
+			ofstream ofs(out);
+			L.expand(G,ofs);
+			ofs.close();
+
+			cout << "done." << endl;
+
+			return 0;
+
+		}
+
+		//verify the checksum before expanding the grammar
+		if(not check_integrity(arc,G)) return 1;
 
 		ofstream ofs(out);
 
 		//expand the grammar to file
-		decompress(A,G,Tc,ofs);
+		if(arc.has_section(RP_SECTION_COLUMNS)){
+
+			//re-interleave the columns
+			column_layout<itype> L(arc.section(RP_SECTION_COLUMNS));
+			L.expand(G,ofs);
+
+		}else{
+
+			decompress(G,ofs);
+
+		}
 
 		ofs.close();
 